@@ -10,21 +10,28 @@ module;
 
 #include <iostream>
 #include <vector>
-#include <thread>
+#include <array>
 #include <chrono>
 #include <memory>
 #include <string>
 #include <cmath>
 #include <random>
-#include <atomic>
 #include <iomanip>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <string_view>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <stdexcept>
 
 export module AdaptiveCruiseControl;
 
 import CANBusSimulation;
+import CANCoroutines;
+import CANFleet;
+import CANDatabase;
 
 using namespace std;
 using namespace std::chrono;
@@ -51,10 +58,10 @@ export namespace AdaptiveCruiseControl {
                     double minOutput = 0.0, double maxOutput = 100.0)
             : kp(proportionalGain), ki(integralGain), integralSum(0.0), 
               previousError(0.0), outputMin(minOutput), outputMax(maxOutput),
-              lastUpdateTime(steady_clock::now()) {}
+              lastUpdateTime(SimulationClock::now()) {}
         
         double calculate(double setpoint, double currentValue) {
-            auto currentTime = steady_clock::now();
+            auto currentTime = SimulationClock::now();
             auto deltaTime = duration_cast<milliseconds>(currentTime - lastUpdateTime).count() / 1000.0;
             
             if (deltaTime <= 0.0) deltaTime = 0.001; // Prevent division by zero
@@ -92,7 +99,7 @@ export namespace AdaptiveCruiseControl {
         void reset() {
             integralSum = 0.0;
             previousError = 0.0;
-            lastUpdateTime = steady_clock::now();
+            lastUpdateTime = SimulationClock::now();
         }
         
         void setGains(double proportionalGain, double integralGain) {
@@ -157,11 +164,20 @@ export namespace AdaptiveCruiseControl {
             return baseResistance + gradeResistance + airResistance;
         }
         
-    public:
-        VehicleDynamics(double vehicleMass = 1500.0) // Default 1500kg car
+        VehicleDynamics(double vehicleMass, mt19937 noiseGenerator)
             : mass(vehicleMass), dragCoefficient(0.3), rollingResistance(0.01),
               currentSpeed(0.0), currentThrottlePosition(0.0), roadCondition(RoadCondition::FLAT),
-              randomGenerator(random_device{}()), noiseDistribution(-0.5, 0.5) {}
+              randomGenerator(noiseGenerator), noiseDistribution(-0.5, 0.5) {}
+        
+    public:
+        // Vehicles sharing a SimulationSeed need distinct noise streams
+        VehicleDynamics(double vehicleMass = 1500.0, uint64_t noiseStream = 0) // Default 1500kg car
+            : VehicleDynamics(vehicleMass,
+                  mt19937(static_cast<mt19937::result_type>(SimulationSeed::derive("VehicleDynamics", noiseStream)))) {}
+        
+        // Noise seeded by the caller, so that runs of a study repeat
+        VehicleDynamics(double vehicleMass, seed_seq& noiseSeed)
+            : VehicleDynamics(vehicleMass, mt19937(noiseSeed)) {}
         
         void updateSpeed(double throttlePosition, double deltaTimeSeconds) {
             currentThrottlePosition = throttlePosition;
@@ -192,13 +208,14 @@ export namespace AdaptiveCruiseControl {
             if (currentSpeed > 200.0) currentSpeed = 200.0;
         }
         
+        double getMass() const { return mass; }
         double getCurrentSpeed() const { return currentSpeed; }
         double getThrottlePosition() const { return currentThrottlePosition; }
         RoadCondition getRoadCondition() const { return roadCondition; }
         
         void setRoadCondition(RoadCondition condition) {
             roadCondition = condition;
-            cout << "[ROAD] Condition changed to: " << getRoadConditionString() << endl;
+            logInfo(LogTag::VEHICLE, "Road condition changed to: {}", getRoadConditionString());
         }
         
         string getRoadConditionString() const {
@@ -226,6 +243,125 @@ export namespace AdaptiveCruiseControl {
         const uint32_t CRUISE_CONTROL_STATUS = 0x400;   // Cruise control system status
         const uint32_t ROAD_CONDITION_UPDATE = 0x500;   // Road condition sensor data
         const uint32_t PI_CONTROLLER_DEBUG = 0x600;     // PI controller debug information
+        
+        // Typed payloads, laid out as in CRUISE_CONTROL_DBC below
+        struct EngineSpeedRequest {
+            uint8_t requestType = 0x01;     // speed
+            
+            using Layout = MessageLayout<ENGINE_SPEED_REQUEST, 1,
+                SignalField<&EngineSpeedRequest::requestType, 0, 8>>;
+        };
+        
+        struct EngineSpeedResponse {
+            double speedKmh = 0.0;
+            uint8_t responseType = 0x01;    // speed
+            uint8_t status = 0x00;          // OK
+            
+            using Layout = MessageLayout<ENGINE_SPEED_RESPONSE, 4,
+                SignalField<&EngineSpeedResponse::speedKmh, 0, 16, 0.1>,
+                SignalField<&EngineSpeedResponse::responseType, 16, 8>,
+                SignalField<&EngineSpeedResponse::status, 24, 8>>;
+        };
+        
+        struct ThrottleCommand {
+            double throttlePercent = 0.0;
+            bool cruiseActive = false;
+            
+            using Layout = MessageLayout<THROTTLE_COMMAND, 4,
+                SignalField<&ThrottleCommand::throttlePercent, 0, 16, 0.01>,
+                SignalField<&ThrottleCommand::cruiseActive, 16, 8>>;
+        };
+        
+        struct VehicleStatus {
+            double speedKmh = 0.0;
+            double throttlePercent = 0.0;
+            RoadCondition roadCondition = RoadCondition::FLAT;
+            uint8_t gear = 0;               // simplified: always 0
+            
+            using Layout = MessageLayout<VEHICLE_STATUS, 8,
+                SignalField<&VehicleStatus::speedKmh, 0, 16, 0.1>,
+                SignalField<&VehicleStatus::throttlePercent, 16, 16, 0.01>,
+                SignalField<&VehicleStatus::roadCondition, 32, 8>,
+                SignalField<&VehicleStatus::gear, 40, 8>>;
+        };
+        
+        struct RoadConditionUpdate {
+            RoadCondition roadCondition = RoadCondition::FLAT;
+            
+            using Layout = MessageLayout<ROAD_CONDITION_UPDATE, 4,
+                SignalField<&RoadConditionUpdate::roadCondition, 0, 8>>;
+        };
+        
+        struct ControllerDebug {
+            double currentSpeedKmh = 0.0;
+            double targetSpeedKmh = 0.0;
+            double throttlePercent = 0.0;
+            double integralSum = 0.0;       // offset by -100 on the wire
+            
+            using Layout = MessageLayout<PI_CONTROLLER_DEBUG, 8,
+                SignalField<&ControllerDebug::currentSpeedKmh, 0, 16, 0.1>,
+                SignalField<&ControllerDebug::targetSpeedKmh, 16, 16, 0.1>,
+                SignalField<&ControllerDebug::throttlePercent, 32, 16, 0.01>,
+                SignalField<&ControllerDebug::integralSum, 48, 16, 0.01, -100.0>>;
+        };
+        
+        // Same bytes the hand-packed frames carried: 0.1 km/h and 0.01 % words, little-endian
+        static_assert(VehicleStatus::Layout::encode({123.4, 56.78, RoadCondition::UPHILL_STEEP, 0})
+                      == array<uint8_t, 8>{0xD2, 0x04, 0x2E, 0x16, 0x02, 0x00, 0x00, 0x00});
+        static_assert(ControllerDebug::Layout::decode(ControllerDebug::Layout::encode({0.0, 0.0, 0.0, -12.5}))
+                      .integralSum == -12.5);
+    }
+    
+    // The messages above as a DBC database (IDs in decimal)
+    constexpr string_view CRUISE_CONTROL_DBC = R"(VERSION ""
+
+BU_: Engine_Control_Unit Vehicle_Simulator Dashboard_Display
+
+BO_ 256 ENGINE_SPEED_REQUEST: 1 Engine_Control_Unit
+ SG_ RequestType : 0|8@1+ (1,0) [0|255] "" Vehicle_Simulator
+
+BO_ 257 ENGINE_SPEED_RESPONSE: 4 Vehicle_Simulator
+ SG_ VehicleSpeed : 0|16@1+ (0.1,0) [0|6553.5] "km/h" Engine_Control_Unit
+ SG_ ResponseType : 16|8@1+ (1,0) [0|255] "" Engine_Control_Unit
+ SG_ Status : 24|8@1+ (1,0) [0|255] "" Engine_Control_Unit
+
+BO_ 512 THROTTLE_COMMAND: 4 Engine_Control_Unit
+ SG_ ThrottlePosition : 0|16@1+ (0.01,0) [0|100] "%" Vehicle_Simulator,Dashboard_Display
+ SG_ CruiseActive : 16|8@1+ (1,0) [0|1] "" Dashboard_Display
+
+BO_ 768 VEHICLE_STATUS: 8 Vehicle_Simulator
+ SG_ VehicleSpeed : 0|16@1+ (0.1,0) [0|6553.5] "km/h" Engine_Control_Unit,Dashboard_Display
+ SG_ ThrottlePosition : 16|16@1+ (0.01,0) [0|100] "%" Dashboard_Display
+ SG_ RoadCondition : 32|8@1+ (1,0) [0|4] "" Dashboard_Display
+ SG_ Gear : 40|8@1+ (1,0) [0|255] "" Dashboard_Display
+
+BO_ 1280 ROAD_CONDITION_UPDATE: 4 Vehicle_Simulator
+ SG_ RoadCondition : 0|8@1+ (1,0) [0|4] "" Vehicle_Simulator
+
+BO_ 1536 PI_CONTROLLER_DEBUG: 8 Engine_Control_Unit
+ SG_ CurrentSpeed : 0|16@1+ (0.1,0) [0|6553.5] "km/h" Dashboard_Display
+ SG_ TargetSpeed : 16|16@1+ (0.1,0) [0|6553.5] "km/h" Dashboard_Display
+ SG_ ThrottlePosition : 32|16@1+ (0.01,0) [0|100] "%" Dashboard_Display
+ SG_ IntegralSum : 48|16@1+ (0.01,-100) [-100|555.35] "" Dashboard_Display
+
+VAL_ 768 RoadCondition 0 "Flat" 1 "Uphill" 2 "Steep" 3 "Downhill" 4 "Steep" ;
+VAL_ 1280 RoadCondition 0 "Flat" 1 "Uphill" 2 "Steep" 3 "Downhill" 4 "Steep" ;
+)";
+    
+    // Parsed once, shared by every node that decodes through it. The ECU
+    // and vehicle encode with the typed layouts and the dashboard decodes
+    // with the DBC, so the two must not drift apart.
+    const CANDatabase& cruiseControlDatabase() {
+        static const CANDatabase database = [] {
+            using namespace CANMessages;
+            CANDatabase parsed = CANDatabase::parse(CRUISE_CONTROL_DBC);
+            if (!layoutsMatch<EngineSpeedRequest::Layout, EngineSpeedResponse::Layout, ThrottleCommand::Layout,
+                              VehicleStatus::Layout, RoadConditionUpdate::Layout, ControllerDebug::Layout>(parsed)) {
+                throw logic_error("CRUISE_CONTROL_DBC disagrees with the CANMessages layouts");
+            }
+            return parsed;
+        }();
+        return database;
     }
 
     // ========================================
@@ -241,92 +377,65 @@ export namespace AdaptiveCruiseControl {
         double currentSpeed;            // Current vehicle speed
         double currentThrottlePosition; // Current throttle position (0-100%)
         bool cruiseControlActive;       // Cruise control state
-        thread controlThread;
-        atomic<bool> running;
+        TimerId controlTimer = 0;
         
-        void controlLoop() {
-            cout << "[ECU] Speed control loop started" << endl;
-            
-            while (running.load()) {
-                if (cruiseControlActive && targetSpeed > 0) {
-                    // Calculate required throttle position using PI controller
-                    double newThrottlePosition = speedController.calculate(targetSpeed, currentSpeed);
-                    
-                    // Send throttle command via CAN
-                    sendThrottleCommand(newThrottlePosition);
-                    
-                    // Send debug information
-                    sendControllerDebugInfo(newThrottlePosition);
-                    
-                    currentThrottlePosition = newThrottlePosition;
-                }
+        // One period of the 20Hz control loop, run by the bus timer wheel
+        void controlStep() {
+            if (cruiseControlActive && targetSpeed > 0) {
+                // Calculate required throttle position using PI controller
+                double newThrottlePosition = speedController.calculate(targetSpeed, currentSpeed);
+                
+                // Send throttle command via CAN
+                sendThrottleCommand(newThrottlePosition);
                 
-                // Request current speed from vehicle
-                requestCurrentSpeed();
+                // Send debug information
+                sendControllerDebugInfo(newThrottlePosition);
                 
-                this_thread::sleep_for(50ms); // 20Hz control loop
+                currentThrottlePosition = newThrottlePosition;
             }
+            
+            // Request current speed from vehicle
+            requestCurrentSpeed();
         }
         
         void sendThrottleCommand(double throttlePosition) {
-            // Encode throttle position as 16-bit value (0-10000 representing 0-100.00%)
-            uint16_t throttleEncoded = static_cast<uint16_t>(throttlePosition * 100);
-            
-            vector<uint8_t> data = {
-                static_cast<uint8_t>(throttleEncoded & 0xFF),
-                static_cast<uint8_t>((throttleEncoded >> 8) & 0xFF),
-                static_cast<uint8_t>(cruiseControlActive ? 0x01 : 0x00),  // Cruise control status
-                static_cast<uint8_t>(0x00)  // Reserved
-            };
-            
-            auto message = canNode->createMessage(CANMessages::THROTTLE_COMMAND, data);
+            using Command = CANMessages::ThrottleCommand;
+            auto message = canNode->createMessage(Command::Layout::id,
+                Command::Layout::encode({throttlePosition, cruiseControlActive}));
             canBus->transmitMessage(message);
         }
         
         void requestCurrentSpeed() {
-            vector<uint8_t> data = {static_cast<uint8_t>(0x01)}; // Request type: speed
-            auto message = canNode->createMessage(CANMessages::ENGINE_SPEED_REQUEST, data);
+            using Request = CANMessages::EngineSpeedRequest;
+            auto message = canNode->createMessage(Request::Layout::id, Request::Layout::encode({}));
             canBus->transmitMessage(message);
         }
         
         void sendControllerDebugInfo(double throttlePosition) {
-            // Send PI controller debug information
-            uint16_t speedEncoded = static_cast<uint16_t>(currentSpeed * 10); // 0.1 km/h resolution
-            uint16_t targetEncoded = static_cast<uint16_t>(targetSpeed * 10);
-            uint16_t throttleEncoded = static_cast<uint16_t>(throttlePosition * 100);
-            uint16_t integralEncoded = static_cast<uint16_t>((speedController.getIntegralSum() + 100) * 100); // Offset for negative values
-            
-            vector<uint8_t> data = {
-                static_cast<uint8_t>(speedEncoded & 0xFF),
-                static_cast<uint8_t>((speedEncoded >> 8) & 0xFF),
-                static_cast<uint8_t>(targetEncoded & 0xFF),
-                static_cast<uint8_t>((targetEncoded >> 8) & 0xFF),
-                static_cast<uint8_t>(throttleEncoded & 0xFF),
-                static_cast<uint8_t>((throttleEncoded >> 8) & 0xFF),
-                static_cast<uint8_t>(integralEncoded & 0xFF),
-                static_cast<uint8_t>((integralEncoded >> 8) & 0xFF)
-            };
-            
-            auto message = canNode->createMessage(CANMessages::PI_CONTROLLER_DEBUG, data);
+            using Debug = CANMessages::ControllerDebug;
+            auto message = canNode->createMessage(Debug::Layout::id, Debug::Layout::encode({
+                currentSpeed, targetSpeed, throttlePosition, speedController.getIntegralSum()}));
             canBus->transmitMessage(message);
         }
         
         void handleCANMessage(const CANMessage& message) {
             switch (message.id) {
-                case CANMessages::ENGINE_SPEED_RESPONSE:
-                    if (message.data.size() >= 2) {
-                        uint16_t speedEncoded = message.data[0] | (message.data[1] << 8);
-                        currentSpeed = speedEncoded / 10.0; // Convert back to km/h
+                case CANMessages::ENGINE_SPEED_RESPONSE: {
+                    CANMessages::EngineSpeedResponse response;
+                    if (CANMessages::EngineSpeedResponse::Layout::decode(message, response)) {
+                        currentSpeed = response.speedKmh;
                     }
                     break;
+                }
                     
-                case CANMessages::VEHICLE_STATUS:
-                    if (message.data.size() >= 4) {
-                        uint16_t vehicleSpeed = message.data[0] | (message.data[1] << 8);
-                        currentSpeed = vehicleSpeed / 10.0;
+                case CANMessages::VEHICLE_STATUS: {
+                    CANMessages::VehicleStatus status;
+                    if (CANMessages::VehicleStatus::Layout::decode(message, status)) {
+                        currentSpeed = status.speedKmh;
                         // Additional vehicle status can be processed here
                     }
                     break;
+                }
             }
         }
         
@@ -335,18 +444,22 @@ export namespace AdaptiveCruiseControl {
                          double kp = 2.0, double ki = 0.1) // Default PI gains
             : canBus(bus), speedController(kp, ki, 0.0, 100.0), // 0-100% throttle range
               targetSpeed(0.0), currentSpeed(0.0), currentThrottlePosition(0.0),
-              cruiseControlActive(false), running(true) {
+              cruiseControlActive(false) {
             
             canNode = make_shared<CANNode>(nodeId, "Engine_Control_Unit");
+            canNode->setAcceptanceFilters({
+                AcceptanceFilter::exact(CANMessages::ENGINE_SPEED_RESPONSE),
+                AcceptanceFilter::exact(CANMessages::VEHICLE_STATUS)
+            });
             canNode->setMessageHandler([this](const CANMessage& msg) {
                 handleCANMessage(msg);
             });
             canBus->addNode(canNode);
             
-            controlThread = thread(&EngineControlUnit::controlLoop, this);
+            controlTimer = canBus->schedulePeriodic(50ms, [this] { controlStep(); }); // 20Hz control loop
+            logInfo(LogTag::ECU, "Speed control loop started");
             
-            cout << "[ECU] Engine Control Unit initialized with PI gains: Kp=" 
-                 << kp << ", Ki=" << ki << endl;
+            logInfo(LogTag::ECU, "Engine Control Unit initialized with PI gains: Kp={}, Ki={}", kp, ki);
         }
         
         ~EngineControlUnit() {
@@ -354,9 +467,9 @@ export namespace AdaptiveCruiseControl {
         }
         
         void shutdown() {
-            running.store(false);
-            if (controlThread.joinable()) {
-                controlThread.join();
+            if (controlTimer != 0) {
+                canBus->cancelTimer(controlTimer);
+                controlTimer = 0;
             }
         }
         
@@ -364,20 +477,19 @@ export namespace AdaptiveCruiseControl {
             targetSpeed = speedKmh;
             cruiseControlActive = true;
             speedController.reset(); // Reset integral term for new setpoint
-            cout << "[ECU] Cruise control activated - Target speed: " 
-                 << targetSpeed << " km/h" << endl;
+            logInfo(LogTag::ECU, "Cruise control activated - Target speed: {} km/h", targetSpeed);
         }
         
         void disableCruiseControl() {
             cruiseControlActive = false;
             targetSpeed = 0.0;
             speedController.reset();
-            cout << "[ECU] Cruise control deactivated" << endl;
+            logInfo(LogTag::ECU, "Cruise control deactivated");
         }
         
         void setPIGains(double kp, double ki) {
             speedController.setGains(kp, ki);
-            cout << "[ECU] PI gains updated - Kp=" << kp << ", Ki=" << ki << endl;
+            logInfo(LogTag::ECU, "PI gains updated - Kp={}, Ki={}", kp, ki);
         }
         
         // Getters for monitoring
@@ -396,112 +508,100 @@ export namespace AdaptiveCruiseControl {
         shared_ptr<CANNode> canNode;
         shared_ptr<CANBus> canBus;
         VehicleDynamics dynamics;
-        thread simulationThread;
-        atomic<bool> running;
+        TimerId simulationTimer = 0;
+        steady_clock::time_point lastTime;
         double currentThrottlePosition;
         
-        void simulationLoop() {
-            auto lastTime = steady_clock::now();
+        // One step of the 50Hz simulation, run by the bus timer wheel
+        void simulationStep() {
+            auto currentTime = canBus->now();
+            auto deltaTime = duration_cast<milliseconds>(currentTime - lastTime).count() / 1000.0;
             
-            while (running.load()) {
-                auto currentTime = steady_clock::now();
-                auto deltaTime = duration_cast<milliseconds>(currentTime - lastTime).count() / 1000.0;
+            if (deltaTime > 0.0) {
+                // Update vehicle dynamics
+                dynamics.updateSpeed(currentThrottlePosition, deltaTime);
                 
-                if (deltaTime > 0.0) {
-                    // Update vehicle dynamics
-                    dynamics.updateSpeed(currentThrottlePosition, deltaTime);
-                    
-                    // Send vehicle status via CAN
-                    sendVehicleStatus();
-                    
-                    lastTime = currentTime;
-                }
+                // Send vehicle status via CAN
+                sendVehicleStatus();
                 
-                this_thread::sleep_for(20ms); // 50Hz simulation rate
+                lastTime = currentTime;
             }
         }
         
         void sendVehicleStatus() {
-            uint16_t speedEncoded = static_cast<uint16_t>(dynamics.getCurrentSpeed() * 10);
-            uint16_t throttleEncoded = static_cast<uint16_t>(currentThrottlePosition * 100);
-            uint8_t roadCondition = static_cast<uint8_t>(dynamics.getRoadCondition());
-            
-            vector<uint8_t> data = {
-                static_cast<uint8_t>(speedEncoded & 0xFF),
-                static_cast<uint8_t>((speedEncoded >> 8) & 0xFF),
-                static_cast<uint8_t>(throttleEncoded & 0xFF),
-                static_cast<uint8_t>((throttleEncoded >> 8) & 0xFF),
-                roadCondition,
-                static_cast<uint8_t>(0x00),  // Gear position (simplified)
-                static_cast<uint8_t>(0x00),  // Reserved
-                static_cast<uint8_t>(0x00)   // Reserved
-            };
-            
-            auto message = canNode->createMessage(CANMessages::VEHICLE_STATUS, data);
+            using Status = CANMessages::VehicleStatus;
+            auto message = canNode->createMessage(Status::Layout::id, Status::Layout::encode({
+                dynamics.getCurrentSpeed(), currentThrottlePosition, dynamics.getRoadCondition()}));
             canBus->transmitMessage(message);
         }
         
         void handleCANMessage(const CANMessage& message) {
             switch (message.id) {
-                case CANMessages::THROTTLE_COMMAND:
-                    if (message.data.size() >= 2) {
-                        uint16_t throttleEncoded = message.data[0] | (message.data[1] << 8);
-                        currentThrottlePosition = throttleEncoded / 100.0;
+                case CANMessages::THROTTLE_COMMAND: {
+                    CANMessages::ThrottleCommand command;
+                    if (CANMessages::ThrottleCommand::Layout::decode(message, command)) {
+                        currentThrottlePosition = command.throttlePercent;
                     }
                     break;
+                }
                     
                 case CANMessages::ENGINE_SPEED_REQUEST:
                     // Respond with current speed
                     respondWithCurrentSpeed();
                     break;
                     
-                case CANMessages::ROAD_CONDITION_UPDATE:
-                    if (message.data.size() >= 1) {
-                        RoadCondition newCondition = static_cast<RoadCondition>(message.data[0]);
-                        dynamics.setRoadCondition(newCondition);
+                case CANMessages::ROAD_CONDITION_UPDATE: {
+                    CANMessages::RoadConditionUpdate update;
+                    if (CANMessages::RoadConditionUpdate::Layout::decode(message, update)) {
+                        dynamics.setRoadCondition(update.roadCondition);
                     }
                     break;
+                }
             }
         }
         
         void respondWithCurrentSpeed() {
-            uint16_t speedEncoded = static_cast<uint16_t>(dynamics.getCurrentSpeed() * 10);
-            
-            vector<uint8_t> data = {
-                static_cast<uint8_t>(speedEncoded & 0xFF),
-                static_cast<uint8_t>((speedEncoded >> 8) & 0xFF),
-                static_cast<uint8_t>(0x01),  // Response type: speed
-                static_cast<uint8_t>(0x00)   // Status: OK
-            };
-            
-            auto message = canNode->createMessage(CANMessages::ENGINE_SPEED_RESPONSE, data);
+            using Response = CANMessages::EngineSpeedResponse;
+            auto message = canNode->createMessage(Response::Layout::id,
+                Response::Layout::encode({dynamics.getCurrentSpeed()}));
             canBus->transmitMessage(message);
         }
         
-    public:
-        VehicleSimulator(shared_ptr<CANBus> bus, uint32_t nodeId, double vehicleMass = 1500.0)
-            : canBus(bus), dynamics(vehicleMass), running(true), currentThrottlePosition(0.0) {
+        VehicleSimulator(shared_ptr<CANBus> bus, uint32_t nodeId, const VehicleDynamics& vehicleDynamics)
+            : canBus(bus), dynamics(vehicleDynamics), lastTime(bus->now()), currentThrottlePosition(0.0) {
             
             canNode = make_shared<CANNode>(nodeId, "Vehicle_Simulator");
+            canNode->setAcceptanceFilters({
+                AcceptanceFilter::exact(CANMessages::THROTTLE_COMMAND),
+                AcceptanceFilter::exact(CANMessages::ENGINE_SPEED_REQUEST),
+                AcceptanceFilter::exact(CANMessages::ROAD_CONDITION_UPDATE)
+            });
             canNode->setMessageHandler([this](const CANMessage& msg) {
                 handleCANMessage(msg);
             });
             canBus->addNode(canNode);
             
-            simulationThread = thread(&VehicleSimulator::simulationLoop, this);
+            simulationTimer = canBus->schedulePeriodic(20ms, [this] { simulationStep(); }); // 50Hz simulation rate
             
-            cout << "[VEHICLE] Vehicle simulator initialized (Mass: " 
-                 << vehicleMass << " kg)" << endl;
+            logInfo(LogTag::VEHICLE, "Vehicle simulator initialized (Mass: {} kg)", dynamics.getMass());
         }
         
+    public:
+        VehicleSimulator(shared_ptr<CANBus> bus, uint32_t nodeId, double vehicleMass = 1500.0,
+                         uint64_t noiseStream = 0)
+            : VehicleSimulator(bus, nodeId, VehicleDynamics(vehicleMass, noiseStream)) {}
+        
+        VehicleSimulator(shared_ptr<CANBus> bus, uint32_t nodeId, double vehicleMass, seed_seq& noiseSeed)
+            : VehicleSimulator(bus, nodeId, VehicleDynamics(vehicleMass, noiseSeed)) {}
+        
         ~VehicleSimulator() {
             shutdown();
         }
         
         void shutdown() {
-            running.store(false);
-            if (simulationThread.joinable()) {
-                simulationThread.join();
+            if (simulationTimer != 0) {
+                canBus->cancelTimer(simulationTimer);
+                simulationTimer = 0;
             }
         }
         
@@ -509,14 +609,8 @@ export namespace AdaptiveCruiseControl {
             dynamics.setRoadCondition(condition);
             
             // Broadcast road condition change via CAN
-            vector<uint8_t> data = {
-                static_cast<uint8_t>(condition),
-                static_cast<uint8_t>(0x00),  // Reserved
-                static_cast<uint8_t>(0x00),  // Reserved
-                static_cast<uint8_t>(0x00)   // Reserved
-            };
-            
-            auto message = canNode->createMessage(CANMessages::ROAD_CONDITION_UPDATE, data);
+            using Update = CANMessages::RoadConditionUpdate;
+            auto message = canNode->createMessage(Update::Layout::id, Update::Layout::encode({condition}));
             canBus->transmitMessage(message);
         }
         
@@ -530,11 +624,25 @@ export namespace AdaptiveCruiseControl {
     // Dashboard Display Node
     // ========================================
     
+    // Decodes everything through the DBC catalog: signal indices are
+    // resolved once here, each frame is decoded in one pass.
     class DashboardDisplay {
     private:
         shared_ptr<CANNode> canNode;
         shared_ptr<CANBus> canBus;
         
+        const CANMessageDefinition& vehicleStatus = cruiseControlDatabase().getMessage("VEHICLE_STATUS");
+        const CANMessageDefinition& controllerDebug = cruiseControlDatabase().getMessage("PI_CONTROLLER_DEBUG");
+        const CANMessageDefinition& throttleCommand = cruiseControlDatabase().getMessage("THROTTLE_COMMAND");
+        const size_t statusSpeed = vehicleStatus.signalIndex("VehicleSpeed");
+        const size_t statusThrottle = vehicleStatus.signalIndex("ThrottlePosition");
+        const size_t statusRoad = vehicleStatus.signalIndex("RoadCondition");
+        const size_t debugSpeed = controllerDebug.signalIndex("CurrentSpeed");
+        const size_t debugTarget = controllerDebug.signalIndex("TargetSpeed");
+        const size_t debugIntegral = controllerDebug.signalIndex("IntegralSum");
+        const size_t commandCruiseActive = throttleCommand.signalIndex("CruiseActive");
+        array<double, 8> signalValues{};
+        
         // Display data
         double currentSpeed;
         double targetSpeed;
@@ -550,6 +658,11 @@ export namespace AdaptiveCruiseControl {
               roadCondition("Unknown") {
             
             canNode = make_shared<CANNode>(nodeId, "Dashboard_Display");
+            canNode->setAcceptanceFilters({
+                AcceptanceFilter::exact(CANMessages::VEHICLE_STATUS),
+                AcceptanceFilter::exact(CANMessages::PI_CONTROLLER_DEBUG),
+                AcceptanceFilter::exact(CANMessages::THROTTLE_COMMAND)
+            });
             canNode->setMessageHandler([this](const CANMessage& msg) {
                 handleCANMessage(msg);
             });
@@ -562,39 +675,27 @@ export namespace AdaptiveCruiseControl {
             switch (message.id) {
                 case CANMessages::VEHICLE_STATUS:
                     if (message.data.size() >= 5) {
-                        uint16_t speedEncoded = message.data[0] | (message.data[1] << 8);
-                        uint16_t throttleEncoded = message.data[2] | (message.data[3] << 8);
-                        uint8_t roadCond = message.data[4];
-                        
-                        currentSpeed = speedEncoded / 10.0;
-                        throttlePosition = throttleEncoded / 100.0;
-                        
-                        switch (static_cast<RoadCondition>(roadCond)) {
-                            case RoadCondition::FLAT: roadCondition = "Flat"; break;
-                            case RoadCondition::UPHILL_MILD: roadCondition = "Uphill"; break;
-                            case RoadCondition::UPHILL_STEEP: roadCondition = "Steep"; break;
-                            case RoadCondition::DOWNHILL_MILD: roadCondition = "Downhill"; break;
-                            case RoadCondition::DOWNHILL_STEEP: roadCondition = "Steep"; break;
-                        }
+                        vehicleStatus.decode(message, signalValues);
+                        currentSpeed = signalValues[statusSpeed];
+                        throttlePosition = signalValues[statusThrottle];
+                        roadCondition = vehicleStatus.signals[statusRoad].describe(message);
                     }
                     break;
                     
                 case CANMessages::PI_CONTROLLER_DEBUG:
                     if (message.data.size() >= 8) {
-                        uint16_t speedEnc = message.data[0] | (message.data[1] << 8);
-                        uint16_t targetEnc = message.data[2] | (message.data[3] << 8);
-                        uint16_t integralEnc = message.data[6] | (message.data[7] << 8);
-                        
-                        currentSpeed = speedEnc / 10.0;
-                        targetSpeed = targetEnc / 10.0;
-                        integralSum = (integralEnc / 100.0) - 100.0; // Remove offset
+                        controllerDebug.decode(message, signalValues);
+                        currentSpeed = signalValues[debugSpeed];
+                        targetSpeed = signalValues[debugTarget];
+                        integralSum = signalValues[debugIntegral];
                         cruiseActive = (targetSpeed > 0);
                     }
                     break;
                     
                 case CANMessages::THROTTLE_COMMAND:
                     if (message.data.size() >= 3) {
-                        cruiseActive = (message.data[2] == 0x01);
+                        throttleCommand.decode(message, signalValues);
+                        cruiseActive = (signalValues[commandCruiseActive] == 1.0);
                     }
                     break;
             }
@@ -615,6 +716,135 @@ export namespace AdaptiveCruiseControl {
         }
     };
 
+    // ========================================
+    // Coroutine Cruise Control (Fleet Scale)
+    // ========================================
+
+    // The ECU and vehicle of the cruise-control loop written as coroutines on
+    // CoroutineNodes: same CAN messages, PI controller and dynamics as the
+    // classes above, but an instance costs a few coroutine frames instead of
+    // threads, so a FleetSimulation runs thousands of them per core.
+    class CoroutineCruiseControl {
+    private:
+        shared_ptr<CANBus> canBus;
+        PIController speedController;
+        VehicleDynamics dynamics;
+        double targetSpeed;
+        double measuredSpeed = 0.0;     // ECU's view, from VEHICLE_STATUS
+        double commandedThrottle = 0.0; // vehicle's view, from THROTTLE_COMMAND
+        
+        // Declared last: their coroutines use the members above
+        CoroutineNode ecuNode;
+        CoroutineNode vehicleNode;
+        
+        using VehicleStatus = CANMessages::VehicleStatus;
+        using ThrottleCommand = CANMessages::ThrottleCommand;
+        
+        CANTask ecuSpeedListener() {
+            VehicleStatus status;
+            while (true) {
+                auto frame = co_await ecuNode.receive(CANMessages::VEHICLE_STATUS);
+                if (VehicleStatus::Layout::decode(*frame, status)) measuredSpeed = status.speedKmh;
+            }
+        }
+        
+        CANTask ecuControlLoop() {
+            auto next = ecuNode.now();
+            while (true) {
+                double throttle = speedController.calculate(targetSpeed, measuredSpeed);
+                auto command = ecuNode.createMessage(ThrottleCommand::Layout::id,
+                    ThrottleCommand::Layout::encode({throttle, true}));
+                co_await ecuNode.transmit(command);
+                co_await ecuNode.sleepUntil(next += 50ms); // 20Hz control loop
+            }
+        }
+        
+        CANTask vehicleThrottleListener() {
+            ThrottleCommand command;
+            while (true) {
+                auto frame = co_await vehicleNode.receive(CANMessages::THROTTLE_COMMAND);
+                if (ThrottleCommand::Layout::decode(*frame, command)) commandedThrottle = command.throttlePercent;
+            }
+        }
+        
+        CANTask vehicleSimulationLoop() {
+            constexpr auto STEP = 20ms;  // 50Hz simulation rate
+            auto next = vehicleNode.now();
+            while (true) {
+                dynamics.updateSpeed(commandedThrottle, duration<double>(STEP).count());
+                
+                auto status = vehicleNode.createMessage(VehicleStatus::Layout::id, VehicleStatus::Layout::encode({
+                    dynamics.getCurrentSpeed(), commandedThrottle, dynamics.getRoadCondition()}));
+                co_await vehicleNode.transmit(status);
+                co_await vehicleNode.sleepUntil(next += STEP);
+            }
+        }
+        
+    public:
+        CoroutineCruiseControl(shared_ptr<CANBus> bus, double targetSpeedKmh,
+                               double kp = 2.5, double ki = 0.15, double vehicleMass = 1500.0,
+                               uint64_t noiseStream = 0)
+            : canBus(bus), speedController(kp, ki, 0.0, 100.0), dynamics(vehicleMass, noiseStream),
+              targetSpeed(targetSpeedKmh),
+              ecuNode(bus, 0x10, "Engine_Control_Unit"),
+              vehicleNode(bus, 0x20, "Vehicle_Simulator") {
+            
+            ecuNode.getNode()->addAcceptanceFilter(AcceptanceFilter::exact(CANMessages::VEHICLE_STATUS));
+            vehicleNode.getNode()->addAcceptanceFilter(AcceptanceFilter::exact(CANMessages::THROTTLE_COMMAND));
+            
+            ecuNode.spawn(ecuSpeedListener());
+            ecuNode.spawn(ecuControlLoop());
+            vehicleNode.spawn(vehicleThrottleListener());
+            vehicleNode.spawn(vehicleSimulationLoop());
+        }
+        
+        double getCurrentSpeed() const { return dynamics.getCurrentSpeed(); }
+        double getTargetSpeed() const { return targetSpeed; }
+        double getThrottlePosition() const { return commandedThrottle; }
+        
+        // One cruise-controlled vehicle per virtual bus, all advanced together
+        // on a shared worker pool
+        static void runFleet(size_t vehicleCount = 1000, steady_clock::duration simulatedTime = 30s) {
+            cout << "\n Coroutine Cruise Control Fleet: " << vehicleCount << " vehicles, "
+                 << duration_cast<seconds>(simulatedTime).count() << " s simulated" << endl;
+            
+            // Per-frame traces from thousands of buses would only flood the log
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+            
+            FleetSimulation fleet;
+            vector<unique_ptr<CoroutineCruiseControl>> vehicles;
+            vehicles.reserve(vehicleCount);
+            for (size_t i = 0; i < vehicleCount; ++i) {
+                auto bus = fleet.createBus();
+                bus->setBitRate(500000);
+                double target = 60.0 + static_cast<double>(i % 5) * 10.0; // 60-100 km/h
+                vehicles.push_back(make_unique<CoroutineCruiseControl>(bus, target, 2.5, 0.15, 1500.0, i));
+            }
+            
+            auto wallStart = steady_clock::now();
+            fleet.runFor(simulatedTime);
+            double wallSeconds = duration<double>(steady_clock::now() - wallStart).count();
+            
+            double totalError = 0.0;
+            for (const auto& vehicle : vehicles) {
+                totalError += abs(vehicle->getCurrentSpeed() - vehicle->getTargetSpeed());
+            }
+            
+            vehicles.clear(); // detach quietly, before the log level is restored
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+            
+            uint64_t frames = fleet.getTotalMessages();
+            cout << " Worker threads:   " << fleet.getPool().size() << endl;
+            cout << " Frames delivered: " << frames << endl;
+            cout << " Wall time:        " << fixed << setprecision(2) << wallSeconds << " s ("
+                 << static_cast<uint64_t>(frames / max(wallSeconds, 1e-9)) << " frames/s)" << endl;
+            cout << " Mean speed error: " << totalError / max<size_t>(vehicleCount, 1) << " km/h" << endl;
+            cout << defaultfloat;
+        }
+    };
+
     // ========================================
     // Adaptive Cruise Control Scenario Runner
     // ========================================
@@ -625,12 +855,30 @@ export namespace AdaptiveCruiseControl {
         unique_ptr<EngineControlUnit> ecu;
         unique_ptr<VehicleSimulator> vehicle;
         unique_ptr<DashboardDisplay> dashboard;
+        unique_ptr<FrameSequenceHash> runHash;
+        
+        // The 20Hz throttle command must reach the vehicle within its period
+        void printControlFrameTiming() const {
+            auto stats = canBus->getLatencyStats(CANMessages::THROTTLE_COMMAND);
+            if (!stats) return;
+            auto ms = [](nanoseconds value) { return value.count() / 1e6; };
+            nanoseconds worstCase = stats->queueing.max + stats->transmission.max;
+            cout << fixed << setprecision(2);
+            cout << "• THROTTLE_COMMAND: " << stats->transmission.count << " frames, queueing p99 "
+                 << ms(stats->queueing.percentile(99)) << " ms, worst delivery " << ms(worstCase)
+                 << " ms, period jitter " << ms(stats->jitter()) << " ms - 50 ms deadline "
+                 << (worstCase <= 50ms ? "met" : "MISSED") << endl;
+            cout << defaultfloat;
+        }
         
     public:
-        AdaptiveCruiseControlScenario() {
+        // TimeMode::VIRTUAL_TIME runs the whole scenario on the simulated clock
+        explicit AdaptiveCruiseControlScenario(TimeMode timeMode = TimeMode::REAL_TIME) {
             // Initialize CAN bus with automotive standard bit rate
-            canBus = make_shared<CANBus>();
+            canBus = make_shared<CANBus>(timeMode);
             canBus->setBitRate(500000); // 500 kbps (common automotive rate)
+            canBus->setLatencyTracking(true);
+            runHash = make_unique<FrameSequenceHash>(canBus);
             
             // Create system components
             ecu = make_unique<EngineControlUnit>(canBus, 0x10, 2.5, 0.15); // Tuned PI gains
@@ -648,43 +896,43 @@ export namespace AdaptiveCruiseControl {
             // Phase 1: Start on flat road
             cout << "\n Phase 1: Starting cruise control on flat road..." << endl;
             ecu->setCruiseSpeed(80.0); // Set cruise control to 80 km/h
-            this_thread::sleep_for(3s);
+            canBus->sleepFor(3s);
             dashboard->printStatus();
             
             // Phase 2: Mild uphill
             cout << "\n Phase 2: Encountering mild uphill (3% grade)..." << endl;
             vehicle->changeRoadCondition(RoadCondition::UPHILL_MILD);
-            this_thread::sleep_for(4s);
+            canBus->sleepFor(4s);
             dashboard->printStatus();
             
             // Phase 3: Steep uphill
             cout << "\n Phase 3: Steep uphill climb (8% grade)..." << endl;
             vehicle->changeRoadCondition(RoadCondition::UPHILL_STEEP);
-            this_thread::sleep_for(5s);
+            canBus->sleepFor(5s);
             dashboard->printStatus();
             
             // Phase 4: Back to flat
             cout << "\n Phase 4: Returning to flat road..." << endl;
             vehicle->changeRoadCondition(RoadCondition::FLAT);
-            this_thread::sleep_for(3s);
+            canBus->sleepFor(3s);
             dashboard->printStatus();
             
             // Phase 5: Downhill
             cout << "\n Phase 5: Mild downhill (3% grade)..." << endl;
             vehicle->changeRoadCondition(RoadCondition::DOWNHILL_MILD);
-            this_thread::sleep_for(4s);
+            canBus->sleepFor(4s);
             dashboard->printStatus();
             
             // Phase 6: Steep downhill
             cout << "\n Phase 6: Steep downhill (8% grade)..." << endl;
             vehicle->changeRoadCondition(RoadCondition::DOWNHILL_STEEP);
-            this_thread::sleep_for(4s);
+            canBus->sleepFor(4s);
             dashboard->printStatus();
             
             // Phase 7: Final flat section
             cout << "\n Phase 7: Final flat section - demonstrating steady state..." << endl;
             vehicle->changeRoadCondition(RoadCondition::FLAT);
-            this_thread::sleep_for(3s);
+            canBus->sleepFor(3s);
             dashboard->printStatus();
             
             cout << "\n Scenario Complete!" << endl;
@@ -693,29 +941,39 @@ export namespace AdaptiveCruiseControl {
             cout << "• Throttle position automatically adjusted to compensate for changing load" << endl;
             cout << "• Integral term accumulated to eliminate steady-state error" << endl;
             cout << "• System demonstrated robust performance on slopes and flat roads" << endl;
+            printControlFrameTiming();
             
             // Demonstrate PI tuning
             cout << "\n BONUS: Demonstrating PI Gain Tuning..." << endl;
             cout << "Changing to aggressive gains (High Kp, Low Ki)..." << endl;
             ecu->setPIGains(5.0, 0.05);
             vehicle->changeRoadCondition(RoadCondition::UPHILL_MILD);
-            this_thread::sleep_for(3s);
+            canBus->sleepFor(3s);
             dashboard->printStatus();
             
             cout << "Changing to conservative gains (Low Kp, High Ki)..." << endl;
             ecu->setPIGains(1.0, 0.3);
-            this_thread::sleep_for(3s);
+            canBus->sleepFor(3s);
             dashboard->printStatus();
             
             // Clean shutdown
             cout << "\n Shutting down cruise control..." << endl;
             ecu->disableCruiseControl();
-            this_thread::sleep_for(1s);
+            canBus->sleepFor(1s);
+            
+            // Same seed + virtual time = same hash; bisect behavior changes with it
+            auto seed = SimulationSeed::get();
+            bool repeatable = seed && canBus->getTimeMode() == TimeMode::VIRTUAL_TIME;
+            cout << "\n Run hash: " << runHash->toString() << " over " << runHash->frameCount() << " frames ("
+                 << (repeatable ? "seed " + to_string(*seed) + ", repeatable" : "not repeatable: needs a seed and virtual time")
+                 << ")" << endl;
             
             cout << "\n Adaptive Cruise Control Demonstration Complete!" << endl;
             cout << "qqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqq" << endl;
         }
         
+        uint64_t getRunHash() const { return runHash->value(); }
+        
         ~AdaptiveCruiseControlScenario() {
             if (ecu) ecu->shutdown();
             if (vehicle) vehicle->shutdown();
@@ -723,4 +981,486 @@ export namespace AdaptiveCruiseControl {
         }
     };
 
+    // ========================================
+    // Monte Carlo Gain Study
+    // ========================================
+
+    // Ranges the batch runner draws from. Every run gets its own gains,
+    // vehicle mass, road sequence and noise stream, drawn from (seed, run
+    // index) so the set of runs does not depend on thread scheduling. The
+    // vehicle noise follows SimulationSeed; set one to repeat a batch exactly.
+    struct MonteCarloConfig {
+        size_t runs = 1000;
+        double targetSpeedKmh = 80.0;
+        double kpMin = 0.5, kpMax = 6.0;
+        double kiMin = 0.02, kiMax = 0.5;
+        double massMinKg = 1000.0, massMaxKg = 2500.0;
+        steady_clock::duration engagePhase = 15s;   // flat road, step response from standstill
+        size_t roadPhases = 5;                      // random road conditions after that
+        steady_clock::duration phaseMin = 3s, phaseMax = 8s;
+        steady_clock::duration steadyWindow = 2s;   // end of each phase used for steady-state error
+        double settlingBand = 0.05;                 // +-5%: the plant noise alone moves ~0.5 km/h a step
+        uint64_t seed = 1;
+        size_t threads = thread::hardware_concurrency();
+    };
+
+    struct CruiseRunParameters {
+        size_t index = 0;
+        double kp = 0.0;
+        double ki = 0.0;
+        double massKg = 0.0;
+        vector<pair<RoadCondition, steady_clock::duration>> roadPhases;
+    };
+
+    struct CruiseRunMetrics {
+        double overshootPercent = 0.0;          // peak above target during the step response
+        double settlingTimeS = numeric_limits<double>::quiet_NaN(); // NaN = never settled
+        double steadyStateErrorKmh = 0.0;       // mean |error| at the end of every phase
+        double meanBusLoadPercent = 0.0;
+        uint64_t frames = 0;
+
+        bool settled() const { return !isnan(settlingTimeS); }
+    };
+
+    struct CruiseRunResult {
+        CruiseRunParameters parameters;
+        CruiseRunMetrics metrics;
+    };
+
+    // Runs thousands of independent cruise-control scenarios (the ECU and
+    // vehicle simulator of AdaptiveCruiseControlScenario, without the
+    // dashboard) on virtual-time buses spread over a worker pool
+    class CruiseControlMonteCarlo {
+    private:
+        static constexpr auto SAMPLE_PERIOD = 20ms;
+
+        MonteCarloConfig config;
+
+        static double percentile(vector<double> values, double p) {
+            if (values.empty()) return numeric_limits<double>::quiet_NaN();
+            size_t rank = static_cast<size_t>(p / 100.0 * (values.size() - 1) + 0.5);
+            nth_element(values.begin(), values.begin() + rank, values.end());
+            return values[rank];
+        }
+
+        static void printRow(const string& name, const vector<double>& values) {
+            double mean = 0.0;
+            for (double value : values) mean += value;
+            mean /= max<size_t>(values.size(), 1);
+            cout << " " << left << setw(24) << name << right
+                 << setw(9) << mean << setw(9) << percentile(values, 5) << setw(9) << percentile(values, 50)
+                 << setw(9) << percentile(values, 95) << setw(9) << percentile(values, 100) << endl;
+        }
+
+    public:
+        explicit CruiseControlMonteCarlo(const MonteCarloConfig& monteCarloConfig = {})
+            : config(monteCarloConfig) {
+            if (config.runs == 0) throw invalid_argument("Monte Carlo study needs at least one run");
+            if (config.kpMin > config.kpMax || config.kiMin > config.kiMax || config.massMinKg > config.massMaxKg
+                || config.phaseMin > config.phaseMax) {
+                throw invalid_argument("Monte Carlo range minimum exceeds its maximum");
+            }
+        }
+
+        const MonteCarloConfig& getConfig() const { return config; }
+
+        CruiseRunParameters sampleRun(size_t index) const {
+            seed_seq sequence{config.seed, static_cast<uint64_t>(index)};
+            mt19937_64 random(sequence);
+            uniform_real_distribution<double> unit(0.0, 1.0);
+            auto between = [&](double low, double high) { return low + (high - low) * unit(random); };
+
+            CruiseRunParameters run;
+            run.index = index;
+            run.kp = between(config.kpMin, config.kpMax);
+            run.ki = between(config.kiMin, config.kiMax);
+            run.massKg = between(config.massMinKg, config.massMaxKg);
+            uniform_int_distribution<int> condition(0, 4);
+            for (size_t i = 0; i < config.roadPhases; ++i) {
+                auto length = duration_cast<steady_clock::duration>(duration<double>(
+                    between(duration<double>(config.phaseMin).count(), duration<double>(config.phaseMax).count())));
+                run.roadPhases.emplace_back(static_cast<RoadCondition>(condition(random)), length);
+            }
+            return run;
+        }
+
+        // One scenario on its own virtual-time bus, built and destroyed on
+        // the calling thread
+        CruiseRunMetrics runOne(const CruiseRunParameters& run) const {
+            auto canBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+            canBus->setBitRate(500000);
+            EngineControlUnit ecu(canBus, 0x10, run.kp, run.ki);
+            // The last word keeps the noise apart from sampleRun()'s stream
+            seed_seq noise{config.seed, static_cast<uint64_t>(run.index), uint64_t{1}};
+            VehicleSimulator vehicle(canBus, 0x20, run.massKg, noise);
+
+            vector<double> speeds;
+            vector<double> busLoads;
+            vector<size_t> phaseEnds;
+            TimerId sampler = canBus->schedulePeriodic(SAMPLE_PERIOD, [&] {
+                speeds.push_back(vehicle.getCurrentSpeed());
+                if (speeds.size() % (1s / SAMPLE_PERIOD) == 0) busLoads.push_back(canBus->getBusLoad());
+            });
+
+            double target = config.targetSpeedKmh;
+            ecu.setCruiseSpeed(target);
+            canBus->sleepFor(config.engagePhase);
+            phaseEnds.push_back(speeds.size());
+            for (const auto& [condition, length] : run.roadPhases) {
+                vehicle.changeRoadCondition(condition);
+                canBus->sleepFor(length);
+                phaseEnds.push_back(speeds.size());
+            }
+            canBus->cancelTimer(sampler);
+            ecu.shutdown();
+            vehicle.shutdown();
+
+            CruiseRunMetrics metrics;
+            metrics.frames = canBus->getTotalMessages();
+
+            // Step response: the engage phase from standstill
+            size_t engageEnd = phaseEnds.front();
+            double band = config.settlingBand * target;
+            double peak = 0.0;
+            size_t lastOutside = SIZE_MAX;
+            for (size_t i = 0; i < engageEnd; ++i) {
+                peak = max(peak, speeds[i]);
+                if (abs(speeds[i] - target) > band) lastOutside = i;
+            }
+            metrics.overshootPercent = max(0.0, (peak - target) / target * 100.0);
+
+            // Settled = inside the band from then on, for at least the steady window
+            size_t window = static_cast<size_t>(config.steadyWindow / SAMPLE_PERIOD);
+            size_t settledAt = lastOutside == SIZE_MAX ? 0 : lastOutside + 1;
+            if (settledAt + window <= engageEnd) {
+                metrics.settlingTimeS = duration<double>(SAMPLE_PERIOD * settledAt).count();
+            }
+
+            size_t phaseStart = 0;
+            double errorSum = 0.0;
+            for (size_t end : phaseEnds) {
+                size_t begin = max(phaseStart, end > window ? end - window : 0);
+                double phaseError = 0.0;
+                for (size_t i = begin; i < end; ++i) phaseError += abs(speeds[i] - target);
+                errorSum += end > begin ? phaseError / (end - begin) : 0.0;
+                phaseStart = end;
+            }
+            metrics.steadyStateErrorKmh = errorSum / phaseEnds.size();
+
+            for (double load : busLoads) metrics.meanBusLoadPercent += load;
+            metrics.meanBusLoadPercent /= max<size_t>(busLoads.size(), 1);
+            return metrics;
+        }
+
+        // All runs in parallel; results are in run order
+        vector<CruiseRunResult> runAll() const {
+            vector<CruiseRunResult> results(config.runs);
+            WorkStealingPool pool(max<size_t>(config.threads, 1));
+            pool.parallelFor(config.runs, [&](size_t i) {
+                results[i].parameters = sampleRun(i);
+                results[i].metrics = runOne(results[i].parameters);
+            });
+            return results;
+        }
+
+        // Distribution of every metric over the batch, then the runs with the
+        // lowest steady-state error among those that settled without more
+        // than 5% overshoot
+        void printSummary(const vector<CruiseRunResult>& results) const {
+            vector<double> overshoot, settling, steadyState, busLoad;
+            for (const auto& result : results) {
+                overshoot.push_back(result.metrics.overshootPercent);
+                if (result.metrics.settled()) settling.push_back(result.metrics.settlingTimeS);
+                steadyState.push_back(result.metrics.steadyStateErrorKmh);
+                busLoad.push_back(result.metrics.meanBusLoadPercent);
+            }
+
+            cout << fixed << setprecision(2);
+            cout << " " << left << setw(24) << "Metric" << right << setw(9) << "Mean" << setw(9) << "P5"
+                 << setw(9) << "Median" << setw(9) << "P95" << setw(9) << "Worst" << endl;
+            printRow("Overshoot (%)", overshoot);
+            printRow("Settling time (s)", settling);
+            printRow("Steady-state err (km/h)", steadyState);
+            printRow("Bus load (%)", busLoad);
+            cout << " Settled within +-" << setprecision(0) << config.settlingBand * 100 << "%: " << settling.size() << " of "
+                 << results.size() << " runs" << endl;
+
+            vector<const CruiseRunResult*> candidates;
+            for (const auto& result : results) {
+                if (result.metrics.settled() && result.metrics.overshootPercent <= 5.0) candidates.push_back(&result);
+            }
+            sort(candidates.begin(), candidates.end(), [](const auto* a, const auto* b) {
+                return a->metrics.steadyStateErrorKmh < b->metrics.steadyStateErrorKmh;
+            });
+            cout << setprecision(2) << "\n Best gains (settled, overshoot <= 5%):" << endl;
+            cout << setw(7) << "Run" << setw(8) << "Kp" << setw(8) << "Ki" << setw(9) << "Mass kg"
+                 << setw(12) << "Overshoot" << setw(10) << "Settle s" << setw(11) << "SS error" << endl;
+            for (size_t i = 0; i < min<size_t>(candidates.size(), 5); ++i) {
+                const auto& [run, metrics] = *candidates[i];
+                cout << setw(7) << run.index << setw(8) << run.kp << setw(8) << run.ki << setw(9) << setprecision(0)
+                     << run.massKg << setprecision(2) << setw(11) << metrics.overshootPercent << "%"
+                     << setw(10) << metrics.settlingTimeS << setw(11) << metrics.steadyStateErrorKmh << endl;
+            }
+            cout << defaultfloat;
+        }
+
+        static void runBatch(size_t runs = 2000) {
+            MonteCarloConfig config;
+            config.runs = runs;
+            CruiseControlMonteCarlo study(config);
+
+            cout << "\n Cruise Control Monte Carlo: " << runs << " runs, Kp " << config.kpMin << "-" << config.kpMax
+                 << ", Ki " << config.kiMin << "-" << config.kiMax << ", mass " << config.massMinKg << "-"
+                 << config.massMaxKg << " kg, target " << config.targetSpeedKmh << " km/h" << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            auto wallStart = steady_clock::now();
+            auto results = study.runAll();
+            double wallSeconds = duration<double>(steady_clock::now() - wallStart).count();
+
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+
+            uint64_t frames = 0;
+            for (const auto& result : results) frames += result.metrics.frames;
+            cout << " " << max<size_t>(config.threads, 1) << " threads, " << fixed << setprecision(2) << wallSeconds
+                 << " s wall, " << static_cast<uint64_t>(frames / max(wallSeconds, 1e-9)) << " frames/s\n" << endl;
+            cout << defaultfloat;
+            study.printSummary(results);
+        }
+    };
+
+    // ========================================
+    // PI Gain Auto-Tuning
+    // ========================================
+
+    // Cost of a gain pair on one road profile: mean |speed error| while
+    // holding speed on the profile's road, plus penalties for overshooting
+    // the engagement and for throttle chatter (high Kp turns the plant
+    // noise into throttle noise). The climb from standstill is throttle-
+    // limited whatever the gains, so its tracking error is not counted.
+    struct TuningCostWeights {
+        double overshoot = 0.5;         // per km/h above target while engaging
+        double throttleActivity = 0.05; // per % mean throttle change per control step
+    };
+
+    struct TunerConfig {
+        double kpMin = 0.1, kpMax = 10.0;       // searched on a log scale
+        double kiMin = 0.0005, kiMax = 1.0;
+        size_t gridSize = 12;                   // candidates per axis and round
+        size_t rounds = 4;                      // each round zooms in around the best candidate
+        double targetSpeedKmh = 80.0;
+        double vehicleMassKg = 1500.0;
+        steady_clock::duration engagePhase = 15s;   // flat road from standstill
+        steady_clock::duration holdPhase = 15s;     // then the profile's road condition
+        TuningCostWeights weights;
+        uint64_t seed = 1;                      // noise streams, shared by every candidate
+        size_t threads = thread::hardware_concurrency();
+    };
+
+    struct TunedGains {
+        double kp = 0.0;
+        double ki = 0.0;
+        double cost = 0.0;
+        array<double, 5> profileCosts{};        // indexed by RoadCondition
+        size_t evaluations = 0;                 // closed-loop simulations run
+    };
+
+    // Searches Kp/Ki by parallel grid refinement. Each candidate is scored on
+    // a closed loop of PIController and VehicleDynamics stepped directly in
+    // virtual time (20 Hz controller, 50 Hz vehicle, no CAN bus), once per
+    // RoadCondition profile; all candidates see the same noise, so their
+    // costs compare exactly.
+    class PIGainTuner {
+    private:
+        static constexpr auto STEP = 10ms;
+        static constexpr auto VEHICLE_PERIOD = 20ms;
+        static constexpr auto CONTROL_PERIOD = 50ms;
+        static constexpr size_t PROFILES = 5;
+
+        TunerConfig config;
+
+        struct SearchBox {
+            double logKpMin, logKpMax, logKiMin, logKiMax;
+        };
+
+    public:
+        explicit PIGainTuner(const TunerConfig& tunerConfig = {}) : config(tunerConfig) {
+            if (config.kpMin <= 0.0 || config.kiMin <= 0.0 || config.kpMin > config.kpMax || config.kiMin > config.kiMax) {
+                throw invalid_argument("Gain ranges must be positive with minimum <= maximum");
+            }
+            if (config.gridSize < 2 || config.rounds == 0) {
+                throw invalid_argument("Tuner needs a grid of at least 2x2 and one round");
+            }
+        }
+
+        const TunerConfig& getConfig() const { return config; }
+
+        // One closed-loop run on a road profile; thread-safe, the simulated
+        // clock is installed on the calling thread for the PI controller
+        double evaluate(double kp, double ki, RoadCondition profile) const {
+            steady_clock::time_point clock{};
+            SimulationClock::Scope clockScope(&clock);
+
+            PIController controller(kp, ki, 0.0, 100.0);
+            seed_seq noise{config.seed, static_cast<uint64_t>(profile)};
+            VehicleDynamics vehicle(config.vehicleMassKg, noise);
+
+            double target = config.targetSpeedKmh;
+            double throttle = 0.0;
+            double absErrorSum = 0.0, throttleChange = 0.0, peak = 0.0;
+            size_t samples = 0, controlSteps = 0;
+            auto engageEnd = clock + config.engagePhase;
+            auto end = engageEnd + config.holdPhase;
+            bool holding = false;
+
+            for (auto step = steady_clock::duration::zero(); clock < end; step += STEP) {
+                clock += STEP;
+                if (!holding && clock > engageEnd) {
+                    vehicle.setRoadCondition(profile);
+                    holding = true;
+                }
+                if (step % VEHICLE_PERIOD == steady_clock::duration::zero()) {
+                    vehicle.updateSpeed(throttle, duration<double>(VEHICLE_PERIOD).count());
+                    double speed = vehicle.getCurrentSpeed();
+                    if (!holding) peak = max(peak, speed);
+                    if (holding) {
+                        absErrorSum += abs(speed - target);
+                        ++samples;
+                    }
+                }
+                if (step % CONTROL_PERIOD == steady_clock::duration::zero()) {
+                    double next = controller.calculate(target, vehicle.getCurrentSpeed());
+                    if (holding) {
+                        throttleChange += abs(next - throttle);
+                        ++controlSteps;
+                    }
+                    throttle = next;
+                }
+            }
+
+            return absErrorSum / max<size_t>(samples, 1)
+                 + config.weights.overshoot * max(0.0, peak - target)
+                 + config.weights.throttleActivity * throttleChange / max<size_t>(controlSteps, 1);
+        }
+
+        // Mean cost over every RoadCondition profile
+        double evaluate(double kp, double ki) const {
+            double total = 0.0;
+            for (size_t profile = 0; profile < PROFILES; ++profile) {
+                total += evaluate(kp, ki, static_cast<RoadCondition>(profile));
+            }
+            return total / PROFILES;
+        }
+
+        // Evaluates a grid over the search box on all cores, then shrinks
+        // the box to +-1.5 grid cells around the best candidate and repeats.
+        // 'onRound' sees the best gains after each round.
+        TunedGains tune(const function<void(size_t round, const TunedGains&)>& onRound = {}) const {
+            SearchBox box{log(config.kpMin), log(config.kpMax), log(config.kiMin), log(config.kiMax)};
+            const SearchBox bounds = box;
+            size_t grid = config.gridSize;
+
+            WorkStealingPool pool(max<size_t>(config.threads, 1));
+            TunedGains best;
+            best.cost = numeric_limits<double>::infinity();
+            vector<double> costs(grid * grid * PROFILES);
+
+            for (size_t round = 0; round < config.rounds; ++round) {
+                auto kpAt = [&](size_t i) { return exp(box.logKpMin + (box.logKpMax - box.logKpMin) * i / (grid - 1)); };
+                auto kiAt = [&](size_t j) { return exp(box.logKiMin + (box.logKiMax - box.logKiMin) * j / (grid - 1)); };
+
+                // One task per candidate and profile keeps every core busy
+                pool.parallelFor(costs.size(), [&](size_t task) {
+                    size_t candidate = task / PROFILES;
+                    costs[task] = evaluate(kpAt(candidate / grid), kiAt(candidate % grid),
+                                           static_cast<RoadCondition>(task % PROFILES));
+                });
+                best.evaluations += costs.size();
+
+                size_t bestCandidate = numeric_limits<size_t>::max();
+                double roundBest = best.cost;
+                for (size_t candidate = 0; candidate < grid * grid; ++candidate) {
+                    double cost = 0.0;
+                    for (size_t profile = 0; profile < PROFILES; ++profile) cost += costs[candidate * PROFILES + profile];
+                    cost /= PROFILES;
+                    if (cost < roundBest) {
+                        roundBest = cost;
+                        bestCandidate = candidate;
+                    }
+                }
+                if (bestCandidate != numeric_limits<size_t>::max()) {
+                    best.kp = kpAt(bestCandidate / grid);
+                    best.ki = kiAt(bestCandidate % grid);
+                    best.cost = roundBest;
+                    for (size_t profile = 0; profile < PROFILES; ++profile) {
+                        best.profileCosts[profile] = costs[bestCandidate * PROFILES + profile];
+                    }
+                }
+                if (onRound) onRound(round, best);
+
+                double kpCell = 1.5 * (box.logKpMax - box.logKpMin) / (grid - 1);
+                double kiCell = 1.5 * (box.logKiMax - box.logKiMin) / (grid - 1);
+                box.logKpMin = max(bounds.logKpMin, log(best.kp) - kpCell);
+                box.logKpMax = min(bounds.logKpMax, log(best.kp) + kpCell);
+                box.logKiMin = max(bounds.logKiMin, log(best.ki) - kiCell);
+                box.logKiMax = min(bounds.logKiMax, log(best.ki) + kiCell);
+            }
+            return best;
+        }
+
+        // Tunes, then checks the result against the scenario's hand-picked
+        // gains, both on the tuner's loop and on the full CAN-bus loop
+        static void runAutoTune() {
+            TunerConfig config;
+            PIGainTuner tuner(config);
+            cout << "\n PI Gain Auto-Tuning: " << config.gridSize << "x" << config.gridSize << " grid, "
+                 << config.rounds << " rounds, Kp " << config.kpMin << "-" << config.kpMax << ", Ki "
+                 << config.kiMin << "-" << config.kiMax << ", " << max<size_t>(config.threads, 1) << " threads" << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            cout << fixed << setprecision(3);
+            auto wallStart = steady_clock::now();
+            TunedGains tuned = tuner.tune([](size_t round, const TunedGains& best) {
+                cout << " Round " << round + 1 << ": Kp " << best.kp << ", Ki " << best.ki
+                     << ", cost " << best.cost << endl;
+            });
+            double wallSeconds = duration<double>(steady_clock::now() - wallStart).count();
+            cout << " " << tuned.evaluations << " closed-loop runs in " << setprecision(2) << wallSeconds << " s" << endl;
+
+            constexpr double HAND_KP = 2.5, HAND_KI = 0.15;    // AdaptiveCruiseControlScenario's gains
+            const char* profiles[] = {"Flat", "Uphill 3%", "Uphill 8%", "Downhill 3%", "Downhill 8%"};
+            cout << "\n " << left << setw(14) << "Profile" << right << setw(14) << "Tuned cost" << setw(14) << "Hand cost" << endl;
+            cout << setprecision(3);
+            for (size_t profile = 0; profile < PROFILES; ++profile) {
+                cout << " " << left << setw(14) << profiles[profile] << right << setw(14) << tuned.profileCosts[profile]
+                     << setw(14) << tuner.evaluate(HAND_KP, HAND_KI, static_cast<RoadCondition>(profile)) << endl;
+            }
+
+            // The same gains on the CAN-bus loop, with a mixed road sequence
+            CruiseControlMonteCarlo canLoop;
+            CruiseRunParameters run = canLoop.sampleRun(0);
+            run.massKg = config.vehicleMassKg;
+            auto check = [&](double kp, double ki) {
+                run.kp = kp;
+                run.ki = ki;
+                return canLoop.runOne(run);
+            };
+            CruiseRunMetrics tunedRun = check(tuned.kp, tuned.ki), handRun = check(HAND_KP, HAND_KI);
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+
+            cout << setprecision(4) << "\n On the CAN bus (" << run.roadPhases.size() << " random road phases):" << endl;
+            cout << " Tuned Kp " << tuned.kp << ", Ki " << tuned.ki << setprecision(2) << ": overshoot " << tunedRun.overshootPercent
+                 << "%, steady-state error " << tunedRun.steadyStateErrorKmh << " km/h" << endl;
+            cout << setprecision(4) << " Hand  Kp " << HAND_KP << ", Ki " << HAND_KI << setprecision(2) << ": overshoot " << handRun.overshootPercent
+                 << "%, steady-state error " << handRun.steadyStateErrorKmh << " km/h" << endl;
+            cout << defaultfloat;
+        }
+    };
+
 } // namespace AdaptiveCruiseControl
@@ -0,0 +1,99 @@
+// CANAllocationTest.cpp : Guards the allocation-free frame path.
+// Counts global operator new calls while frames go through
+// transmitMessage -> arbitration -> broadcast on a virtual-time bus and
+// fails (exit code 1) if any steady-state frame allocates.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+import CANLogging;
+import CANBusSimulation;
+
+using namespace std;
+using namespace std::chrono;
+using namespace CANSim;
+
+namespace {
+    atomic<uint64_t> allocationCount{0};
+}
+
+// GCC flags free() on memory from operator new once these get inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* memory = malloc(size ? size : 1)) return memory;
+    throw bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+int main() {
+    constexpr size_t WARM_UP_FRAMES = 64;
+    constexpr size_t MEASURED_FRAMES = 1000;
+
+    Logger::instance().setLevel(LogLevel::WARNING);
+
+    auto bus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME, 256);
+    bus->setBitRate(500000);
+    uint64_t delivered = 0;
+    for (uint32_t i = 0; i < 4; ++i) {
+        auto node = make_shared<CANNode>(i + 1, "Receiver_" + to_string(i + 1));
+        node->setMessageHandler([&delivered](const CANMessage&) { ++delivered; });
+        bus->addNode(node);
+    }
+
+    // Senders are not bus nodes, so every frame reaches all four receivers
+    array<uint8_t, 8> data = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0};
+    CANMessage frames[] = {
+        CANMessage(0x123, data, CANFormat::STANDARD, 101),
+        CANMessage(0x0F0, data, CANFormat::STANDARD, 102),
+        CANMessage(0x1ABCDE, data, CANFormat::EXTENDED, 103),
+    };
+
+    auto sendRound = [&](size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            // Two contenders per round, so arbitration has a loser to requeue
+            const CANMessage& first = frames[i % 3];
+            const CANMessage& second = frames[(i + 1) % 3];
+            if (!bus->transmitMessage(first) || !bus->transmitMessage(second)) {
+                cerr << "Transmit ring rejected a frame" << endl;
+                exit(1);
+            }
+            bus->runUntil(bus->now() + bus->frameDuration(first) + bus->frameDuration(second) + 1ms);
+        }
+    };
+
+    // First frames size the timer wheel, the arbitration table and the
+    // thread-local log buffers
+    sendRound(WARM_UP_FRAMES);
+
+    uint64_t deliveredBefore = delivered;
+    uint64_t before = allocationCount.load(memory_order_relaxed);
+    sendRound(MEASURED_FRAMES);
+    uint64_t allocations = allocationCount.load(memory_order_relaxed) - before;
+    uint64_t deliveries = delivered - deliveredBefore;
+
+    bus->shutdown();
+
+    cout << "Frames: " << 2 * MEASURED_FRAMES << ", deliveries: " << deliveries
+         << ", allocations: " << allocations << endl;
+    if (deliveries != 2 * MEASURED_FRAMES * 4) {
+        cerr << "FAIL: expected " << 2 * MEASURED_FRAMES * 4 << " deliveries" << endl;
+        return 1;
+    }
+    if (allocations != 0) {
+        cerr << "FAIL: the TX -> arbitrate -> broadcast path allocated" << endl;
+        return 1;
+    }
+    cout << "PASS" << endl;
+    return 0;
+}
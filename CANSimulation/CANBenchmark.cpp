@@ -0,0 +1,380 @@
+// CANBenchmark.cpp : Benchmarks of the CAN simulation core.
+// Prints a table and writes the results as JSON so runs can be compared
+// between commits:
+//   can_benchmark [--out results.json] [--label <commit>] [--filter <name>] [--quick]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+import CANLogging;
+import CANBusSimulation;
+
+using namespace std;
+using namespace std::chrono;
+using namespace CANSim;
+
+namespace {
+
+    // ========================================
+    // Measurement
+    // ========================================
+
+    struct BenchmarkResult {
+        string name;
+        vector<pair<string, int64_t>> params;
+        uint64_t operations = 0;    // what one "op" is depends on the benchmark
+        double seconds = 0.0;       // best repetition
+
+        double nsPerOp() const { return operations ? seconds * 1e9 / operations : 0.0; }
+        double opsPerSecond() const { return seconds > 0.0 ? operations / seconds : 0.0; }
+    };
+
+    struct BenchmarkOptions {
+        string outputPath;
+        string label;
+        string filter;
+        nanoseconds minTime = 200ms;    // per repetition of a micro benchmark
+        int repetitions = 5;
+    };
+
+    // Keeps the optimizer from dropping a computed value
+    volatile uint64_t benchmarkSink;
+
+    template<typename T>
+    void keep(const T& value) {
+        benchmarkSink = static_cast<uint64_t>(value);
+    }
+
+    // Grows a batch until it runs for minTime, then reports the best of
+    // 'repetitions' batches of that size. body(n) runs n operations.
+    template<typename Body>
+    BenchmarkResult measure(const BenchmarkOptions& options, string name,
+                            vector<pair<string, int64_t>> params, Body&& body) {
+        uint64_t batch = 1;
+        for (;;) {
+            auto start = steady_clock::now();
+            body(batch);
+            if (steady_clock::now() - start >= options.minTime / 4 || batch >= (1ull << 40)) break;
+            batch *= 2;
+        }
+        batch *= 4;
+
+        BenchmarkResult result{std::move(name), std::move(params), batch, 1e300};
+        for (int i = 0; i < options.repetitions; ++i) {
+            auto start = steady_clock::now();
+            body(batch);
+            result.seconds = min(result.seconds, duration<double>(steady_clock::now() - start).count());
+        }
+        return result;
+    }
+
+    // Best of 'repetitions' runs of a fixed-size scenario; run() returns its
+    // own timed seconds so setup and teardown stay outside the measurement
+    template<typename Run>
+    BenchmarkResult measureRuns(const BenchmarkOptions& options, string name,
+                                vector<pair<string, int64_t>> params, uint64_t operations, Run&& run) {
+        BenchmarkResult result{std::move(name), std::move(params), operations, 1e300};
+        for (int i = 0; i < options.repetitions; ++i) {
+            result.seconds = min(result.seconds, run());
+        }
+        return result;
+    }
+
+    // ========================================
+    // Benchmarks
+    // ========================================
+
+    CANMessage sampleFrame(uint32_t id, uint32_t source = 0) {
+        array<uint8_t, 8> data = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0};
+        return CANMessage(id, data, CANFormat::STANDARD, source);
+    }
+
+    // CANArbitration::arbitrate over n contending frames
+    void benchArbitrate(const BenchmarkOptions& options, vector<BenchmarkResult>& results) {
+        mt19937 random(42);
+        uniform_int_distribution<uint32_t> ids(0, CAN_MAX_STANDARD_ID);
+        for (int contenders : {2, 8, 32, 128}) {
+            vector<CANMessage> frames;
+            for (int i = 0; i < contenders; ++i) frames.push_back(sampleFrame(ids(random)));
+
+            results.push_back(measure(options, "arbitrate", {{"contenders", contenders}}, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    CANMessage winner = CANArbitration::arbitrate(frames);
+                    keep(winner.id);
+                }
+            }));
+        }
+    }
+
+    // CANMessage::toString and its allocation-free formatTo
+    void benchToString(const BenchmarkOptions& options, vector<BenchmarkResult>& results) {
+        CANMessage frame = sampleFrame(0x123, 7);
+        results.push_back(measure(options, "message_to_string", {{"payload_bytes", 8}}, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                string text = frame.toString();
+                keep(text.size());
+            }
+        }));
+
+        char buffer[320];
+        results.push_back(measure(options, "message_format_to", {{"payload_bytes", 8}}, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                keep(frame.formatTo(buffer, sizeof(buffer)));
+            }
+        }));
+    }
+
+    // transmitMessage from 1..N threads into one bus's lock-free transmit
+    // ring. A virtual-time bus has no bus thread, so only the enqueue path
+    // is timed; the ring is sized for every frame of the run.
+    void benchTransmit(const BenchmarkOptions& options, vector<BenchmarkResult>& results, bool quick) {
+        const size_t totalFrames = quick ? (1u << 16) : (1u << 18);
+        unsigned maxProducers = max(2u, thread::hardware_concurrency());
+
+        for (unsigned producers = 1; producers <= maxProducers; producers *= 2) {
+            size_t perProducer = totalFrames / producers;
+            results.push_back(measureRuns(options, "transmit_message", {{"producers", producers}},
+                                          perProducer * producers, [&] {
+                auto bus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME, totalFrames);
+                bus->setQueueFullPolicy(QueueFullPolicy::REJECT);
+
+                atomic<unsigned> ready{0};
+                atomic<bool> go{false};
+                vector<thread> threads;
+                for (unsigned p = 0; p < producers; ++p) {
+                    threads.emplace_back([&, p] {
+                        CANMessage frame = sampleFrame(0x100 + p, p + 1);
+                        ready.fetch_add(1);
+                        while (!go.load(memory_order_acquire)) this_thread::yield();
+                        for (size_t i = 0; i < perProducer; ++i) {
+                            if (!bus->transmitMessage(frame)) abort();  // ring is sized for the run
+                        }
+                    });
+                }
+                while (ready.load() < producers) this_thread::yield();
+
+                auto start = steady_clock::now();
+                go.store(true, memory_order_release);
+                for (auto& t : threads) t.join();
+                double seconds = duration<double>(steady_clock::now() - start).count();
+
+                bus->shutdown();
+                return seconds;
+            }));
+        }
+    }
+
+    // Delivery of one frame to n receiving nodes (virtual time, so the
+    // cost is arbitration, the completion timer and the handler calls)
+    void benchFanOut(const BenchmarkOptions& options, vector<BenchmarkResult>& results, bool quick) {
+        const size_t frames = quick ? 2048 : 8192;
+        for (int receivers : {1, 8, 64, 256}) {
+            results.push_back(measureRuns(options, "broadcast_fan_out", {{"receivers", receivers}}, frames, [&] {
+                auto bus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME, frames);
+                bus->setBitRate(1000000);
+                uint64_t delivered = 0;
+                for (int i = 0; i < receivers; ++i) {
+                    auto node = make_shared<CANNode>(i + 1, "Receiver_" + to_string(i + 1));
+                    node->setMessageHandler([&delivered](const CANMessage&) { ++delivered; });
+                    bus->addNode(node);
+                }
+
+                CANMessage frame = sampleFrame(0x123);
+                for (size_t i = 0; i < frames; ++i) bus->transmitMessage(frame);
+                auto until = bus->now() + bus->frameDuration(frame) * (frames + 1);
+
+                auto start = steady_clock::now();
+                bus->runUntil(until);
+                double seconds = duration<double>(steady_clock::now() - start).count();
+
+                if (delivered != frames * receivers) abort();
+                bus->shutdown();
+                return seconds;
+            }));
+        }
+    }
+
+    // Sensors and controllers on a virtual-time bus: delivered frames per
+    // second of wall time for a fixed stretch of simulated time
+    void benchVirtualTime(const BenchmarkOptions& options, vector<BenchmarkResult>& results, bool quick) {
+        const auto simulated = quick ? 2s : 10s;
+        for (int sensors : {4, 16}) {
+            uint64_t frames = 0;
+            auto result = measureRuns(options, "virtual_time_end_to_end", {{"sensors", sensors}}, 0, [&] {
+                auto bus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+                bus->setBitRate(1000000);
+                vector<unique_ptr<ControllerNode>> controllers;
+                vector<unique_ptr<SensorNode>> nodes;
+                for (int i = 0; i < 2; ++i) {
+                    controllers.push_back(make_unique<ControllerNode>(bus, 100 + i));
+                }
+                // Periods grow with the sensor count, so bus load stays near 25%
+                for (int i = 0; i < sensors; ++i) {
+                    nodes.push_back(make_unique<SensorNode>(bus, i + 1, 0x100 + i,
+                                                            milliseconds(sensors / 4 * (1 + i % 4))));
+                }
+
+                auto start = steady_clock::now();
+                bus->sleepFor(simulated);
+                double seconds = duration<double>(steady_clock::now() - start).count();
+
+                frames = bus->getTotalMessages();
+                for (auto& node : nodes) node->stop();
+                bus->shutdown();
+                return seconds;
+            });
+            result.operations = frames;
+            result.params.push_back({"simulated_ms", duration_cast<milliseconds>(simulated).count()});
+            results.push_back(result);
+        }
+    }
+
+    // ========================================
+    // Reporting
+    // ========================================
+
+    string jsonEscape(const string& text) {
+        string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", c);
+                out += code;
+            } else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    string compilerName() {
+    #if defined(__clang__)
+        return "clang " __clang_version__;
+    #elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+    #elif defined(_MSC_VER)
+        return "msvc " + to_string(_MSC_FULL_VER);
+    #else
+        return "unknown";
+    #endif
+    }
+
+    void writeJson(ostream& out, const BenchmarkOptions& options, const vector<BenchmarkResult>& results) {
+        auto timestamp = duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+    #ifdef NDEBUG
+        const char* buildType = "release";
+    #else
+        const char* buildType = "debug";
+    #endif
+
+        out << "{\n";
+        out << "  \"suite\": \"can_benchmark\",\n";
+        out << "  \"label\": \"" << jsonEscape(options.label) << "\",\n";
+        out << "  \"timestamp\": " << timestamp << ",\n";
+        out << "  \"compiler\": \"" << jsonEscape(compilerName()) << "\",\n";
+        out << "  \"build\": \"" << buildType << "\",\n";
+        out << "  \"hardware_threads\": " << thread::hardware_concurrency() << ",\n";
+        out << "  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& result = results[i];
+            char numbers[128];
+            snprintf(numbers, sizeof(numbers), "\"seconds\": %.6g, \"ns_per_op\": %.4g, \"ops_per_sec\": %.6g",
+                     result.seconds, result.nsPerOp(), result.opsPerSecond());
+
+            out << "    {\"name\": \"" << jsonEscape(result.name) << "\", \"params\": {";
+            for (size_t p = 0; p < result.params.size(); ++p) {
+                out << (p ? ", " : "") << "\"" << jsonEscape(result.params[p].first) << "\": "
+                    << result.params[p].second;
+            }
+            out << "}, \"ops\": " << result.operations << ", " << numbers << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n";
+        out << "}\n";
+    }
+
+    void printTable(const vector<BenchmarkResult>& results) {
+        printf("%-26s %-28s %14s %14s\n", "Benchmark", "Parameters", "ns/op", "ops/s");
+        for (const auto& result : results) {
+            string params;
+            for (const auto& [key, value] : result.params) {
+                if (!params.empty()) params += ' ';
+                params += key + "=" + to_string(value);
+            }
+            printf("%-26s %-28s %14.2f %14.4g\n", result.name.c_str(), params.c_str(),
+                   result.nsPerOp(), result.opsPerSecond());
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            options.outputPath = argv[++i];
+        } else if (arg == "--label" && i + 1 < argc) {
+            options.label = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--quick") {
+            quick = true;
+            options.minTime = 50ms;
+            options.repetitions = 3;
+        } else {
+            cerr << "usage: " << argv[0] << " [--out results.json] [--label <text>] [--filter <name>] [--quick]\n";
+            return 2;
+        }
+    }
+
+    // Frame logging would dominate every measurement
+    Logger::instance().setLevel(LogLevel::ERROR);
+
+    struct Suite {
+        const char* name;
+        void (*run)(const BenchmarkOptions&, vector<BenchmarkResult>&, bool);
+    };
+    const Suite suites[] = {
+        {"arbitrate", [](const BenchmarkOptions& o, vector<BenchmarkResult>& r, bool) { benchArbitrate(o, r); }},
+        {"message_to_string", [](const BenchmarkOptions& o, vector<BenchmarkResult>& r, bool) { benchToString(o, r); }},
+        {"transmit_message", benchTransmit},
+        {"broadcast_fan_out", benchFanOut},
+        {"virtual_time_end_to_end", benchVirtualTime},
+    };
+
+    vector<BenchmarkResult> results;
+    for (const auto& suite : suites) {
+        if (!options.filter.empty() && string(suite.name).find(options.filter) == string::npos) continue;
+        suite.run(options, results, quick);
+    }
+    Logger::instance().flush();
+
+    printTable(results);
+    if (!options.outputPath.empty()) {
+        ofstream file(options.outputPath);
+        if (!file) {
+            cerr << "Cannot write " << options.outputPath << "\n";
+            return 1;
+        }
+        writeJson(file, options, results);
+        cout << "\nResults written to " << options.outputPath << endl;
+    } else {
+        cout << "\n";
+        writeJson(cout, options, results);
+    }
+    return 0;
+}
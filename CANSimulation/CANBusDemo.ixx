@@ -9,10 +9,26 @@ module;
 #include <chrono>
 #include <memory>
 #include <string>
+#include <iomanip>
+#include <array>
+#include <span>
+#include <filesystem>
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+#include <string_view>
+#include <sstream>
 
 export module CANBusDemo;
 
 import CANBusSimulation;
+import CANFleet;
+import CANGateway;
+import CANTrace;
+import CANLogImport;
+import CANDatabase;
+import CANLoadGenerator;
+import HeadlightControl;
 
 using namespace std;
 using namespace std::chrono;
@@ -152,6 +168,10 @@ export namespace CANDemo {
             auto dashboard = make_shared<CANNode>(0x30, "Dashboard");
             auto abs = make_shared<CANNode>(0x40, "ABS_ECU");
 
+            // Only deliver the frames each ECU cares about
+            dashboard->setAcceptanceFilters({AcceptanceFilter::exact(0x200), AcceptanceFilter::exact(0x300)});
+            abs->addAcceptanceFilter(AcceptanceFilter::exact(0x300));
+
             // Set up message handlers
             dashboard->setMessageHandler([](const CANMessage& msg) {
                 if (msg.id == 0x200 && msg.data.size() >= 4) { // Engine data
@@ -219,12 +239,14 @@ export namespace CANDemo {
 
     class IndustrialCANDemo {
     public:
-        static void runFactoryAutomationDemo() {
+        // TimeMode::VIRTUAL_TIME runs the same scenario on the simulated clock,
+        // finishing in milliseconds with the same message timeline
+        static void runFactoryAutomationDemo(TimeMode timeMode = TimeMode::REAL_TIME) {
             cout << "\n" << string(60, '=') << endl;
             cout << "    INDUSTRIAL CAN DEMO - FACTORY AUTOMATION" << endl;
             cout << string(60, '=') << endl;
 
-            auto canBus = make_shared<CANBus>();
+            auto canBus = make_shared<CANBus>(timeMode);
             canBus->setBitRate(1000000); // 1 Mbps for industrial applications
 
             cout << "\nSimulating Industrial CAN Network:" << endl;
@@ -238,8 +260,8 @@ export namespace CANDemo {
             auto tempSensor2 = make_unique<SensorNode>(canBus, 0x02, 0x101, 2500ms);
             auto pressureSensor = make_unique<SensorNode>(canBus, 0x03, 0x110, 1500ms);
 
-            // Create controller node (PLC)
-            auto plc = make_unique<ControllerNode>(canBus, 0x50);
+            // Create controller node (PLC), listening to the sensor data block only
+            auto plc = make_unique<ControllerNode>(canBus, 0x50, vector{AcceptanceFilter::range(0x100, 0x1FF)});
 
             cout << "\nStarting industrial automation simulation..." << endl;
             cout << "- Sensors will send periodic data" << endl;
@@ -247,19 +269,766 @@ export namespace CANDemo {
             cout << "- Simulation will run for 10 seconds" << endl;
 
             // Let simulation run
-            this_thread::sleep_for(100s);
+            canBus->sleepFor(100s);
 
             cout << "\nStopping simulation..." << endl;
             tempSensor1->stop();
             tempSensor2->stop();
             pressureSensor->stop();
 
-            this_thread::sleep_for(500ms);
+            canBus->sleepFor(500ms);
             canBus->printStatus();
             canBus->shutdown();
         }
     };
 
+    // ========================================
+    // Fleet-Scale Simulation
+    // ========================================
+
+    class FleetCANDemo {
+    public:
+        // One factory-style bus per vehicle, all advanced in parallel on a
+        // worker pool sized to the machine instead of a thread per bus/node
+        static void runFleetDemo(size_t vehicleCount = 100, steady_clock::duration simulatedTime = 60s) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    FLEET CAN DEMO - " << vehicleCount << " VEHICLES ON A SHARED POOL" << endl;
+            cout << string(60, '=') << endl;
+
+            // Per-frame traces from hundreds of buses would only flood the log
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            FleetSimulation fleet;
+            vector<unique_ptr<SensorNode>> sensors;
+            vector<unique_ptr<ControllerNode>> controllers;
+            for (size_t vehicle = 0; vehicle < vehicleCount; ++vehicle) {
+                auto canBus = fleet.createBus();
+                canBus->setBitRate(500000);
+                sensors.push_back(make_unique<SensorNode>(canBus, 0x01, 0x100, 10ms));
+                sensors.push_back(make_unique<SensorNode>(canBus, 0x02, 0x101, 20ms));
+                sensors.push_back(make_unique<SensorNode>(canBus, 0x03, 0x110, 50ms));
+                controllers.push_back(make_unique<ControllerNode>(canBus, 0x50));
+            }
+
+            cout << "Worker threads: " << fleet.getPool().size() << endl;
+            cout << "Simulating " << duration_cast<seconds>(simulatedTime).count() << " s on every bus..." << endl;
+
+            auto wallStart = steady_clock::now();
+            fleet.runFor(simulatedTime);
+            double wallSeconds = duration<double>(steady_clock::now() - wallStart).count();
+
+            for (auto& sensor : sensors) {
+                sensor->stop();
+            }
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+
+            uint64_t frames = fleet.getTotalMessages();
+            cout << "Frames delivered: " << frames << endl;
+            cout << "Wall time: " << fixed << setprecision(2) << wallSeconds << " s ("
+                 << static_cast<uint64_t>(frames / max(wallSeconds, 1e-9)) << " frames/s)" << endl;
+            cout << defaultfloat;
+        }
+    };
+
+    // ========================================
+    // Multi-Bus Gateway
+    // ========================================
+
+    class GatewayCANDemo {
+    public:
+        // Powertrain, chassis and body buses joined by a central gateway. The
+        // buses run as separate tasks of a FleetSimulation, so each one is
+        // processed on its own worker while frames cross between them.
+        static void runGatewayDemo(steady_clock::duration simulatedTime = 10s) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    GATEWAY DEMO - POWERTRAIN / CHASSIS / BODY" << endl;
+            cout << string(60, '=') << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            FleetSimulation fleet(3);
+            fleet.setSliceLength(1ms);     // bounds how far one bus runs ahead of another
+            auto powertrainBus = fleet.createBus();
+            auto chassisBus = fleet.createBus();
+            auto bodyBus = fleet.createBus();
+            powertrainBus->setBitRate(500000);
+            chassisBus->setBitRate(500000);
+            bodyBus->setBitRate(125000);
+
+            vector<unique_ptr<SensorNode>> sensors;
+            sensors.push_back(make_unique<SensorNode>(powertrainBus, 0x01, 0x100, 10ms));  // engine speed
+            sensors.push_back(make_unique<SensorNode>(powertrainBus, 0x02, 0x101, 20ms));  // engine temperature
+            sensors.push_back(make_unique<SensorNode>(chassisBus, 0x03, 0x180, 5ms));      // wheel speeds
+            // Engine speed copy from the gateway plus the forwarded wheel speeds
+            ControllerNode dashboard(bodyBus, 0x50, {AcceptanceFilter::exact(0x310), AcceptanceFilter::range(0x180, 0x18F)});
+
+            CANGateway gateway(0x7F0, "Central Gateway");
+            size_t powertrain = gateway.addBus(powertrainBus, "Powertrain");
+            size_t chassis = gateway.addBus(chassisBus, "Chassis");
+            size_t body = gateway.addBus(bodyBus, "Body");
+
+            // Engine frames to the chassis ECUs; the body bus only gets a
+            // 10 Hz copy of engine speed under its own ID
+            gateway.addRoute(GatewayRoute::forward(powertrain, chassis, AcceptanceFilter::idMask(0x100, 0x7FE)));
+            gateway.addRoute(GatewayRoute::forward(powertrain, body, AcceptanceFilter::exact(0x100))
+                                 .translateTo(0x310).limitRate(10.0));
+            gateway.addRoute(GatewayRoute::forward(chassis, body, AcceptanceFilter::range(0x180, 0x18F)));
+            gateway.start();
+
+            cout << "Simulating " << duration_cast<seconds>(simulatedTime).count() << " s..." << endl;
+            fleet.runFor(simulatedTime);
+
+            for (auto& sensor : sensors) {
+                sensor->stop();
+            }
+            gateway.printStatistics();
+            gateway.stop();
+            cout << "Body dashboard: engine speed (0x310) " << (dashboard.getLastData(0x310).empty() ? "missing" : "received")
+                 << ", wheel speeds (0x180) " << (dashboard.getLastData(0x180).empty() ? "missing" : "received") << endl;
+
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+        }
+    };
+
+    // ========================================
+    // Error Confinement
+    // ========================================
+
+    class ErrorConfinementDemo {
+    private:
+        struct Scenario {
+            string name;
+            double bitErrorRate;
+            CANNodeFault fault;         // applied to the faulty node (ID 0x09)
+        };
+
+        // Runs three healthy ECUs plus one faulty node and reports what the
+        // healthy traffic sees: delivered frames and queueing latency
+        static void runScenario(const Scenario& scenario, steady_clock::duration simulatedTime) {
+            auto canBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+            canBus->setBitRate(500000);
+            canBus->setBitErrorRate(scenario.bitErrorRate);
+
+            vector<unique_ptr<SensorNode>> sensors;
+            sensors.push_back(make_unique<SensorNode>(canBus, 0x01, 0x080, 5ms));     // brakes
+            sensors.push_back(make_unique<SensorNode>(canBus, 0x02, 0x100, 10ms));    // engine
+            sensors.push_back(make_unique<SensorNode>(canBus, 0x03, 0x300, 20ms));    // body
+            sensors.push_back(make_unique<SensorNode>(canBus, 0x09, 0x0F0, 10ms));    // faulty ECU
+            canBus->setNodeFault(0x09, scenario.fault);
+
+            uint64_t delivered = 0;
+            nanoseconds totalLatency{0};
+            nanoseconds maxLatency{0};
+            auto monitor = make_shared<CANNode>(0x60, "Monitor");
+            monitor->setMessageHandler([&](const CANMessage& message) {
+                if (message.nodeId == 0x09) return;
+                auto latency = duration_cast<nanoseconds>(canBus->now() - message.timestamp);
+                delivered++;
+                totalLatency += latency;
+                maxLatency = max(maxLatency, latency);
+            });
+            canBus->addNode(monitor);
+
+            canBus->sleepFor(simulatedTime);
+            for (auto& sensor : sensors) {
+                sensor->stop();
+            }
+
+            auto faults = canBus->getFaultStats();
+            double seconds = duration<double>(simulatedTime).count();
+            cout << left << setw(24) << scenario.name << right
+                 << setw(10) << static_cast<uint64_t>(delivered / seconds)
+                 << setw(10) << fixed << setprecision(0)
+                 << (delivered ? totalLatency.count() / 1000.0 / delivered : 0.0)
+                 << setw(10) << maxLatency.count() / 1000.0
+                 << setw(10) << faults.errorFrames
+                 << setw(9) << faults.busOffEvents
+                 << setw(6) << canBus->getBusLoad() << "%" << defaultfloat << endl;
+        }
+
+    public:
+        // Healthy traffic under bus noise, a node with a bad receiver (drives
+        // itself error passive) and one with a bad transmitter (bus-off and
+        // recovery after 128 x 11 recessive bits, again and again)
+        static void runErrorStormDemo(steady_clock::duration simulatedTime = 2s) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    ERROR CONFINEMENT - ERROR STORMS vs HEALTHY TRAFFIC" << endl;
+            cout << string(60, '=') << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::ERROR);
+
+            vector<Scenario> scenarios = {
+                {"Clean bus", 0.0, {}},
+                {"Noise (BER 1e-4)", 1e-4, {}},
+                {"Noise (BER 1e-3)", 1e-3, {}},
+                {"Faulty receiver", 0.0, {0.0, 0.5, 0.0}},
+                {"Faulty transmitter", 0.0, {0.9, 0.0, 0.0}},
+                {"Overloaded receiver", 0.0, {0.0, 0.0, 0.5}},
+            };
+
+            cout << left << setw(24) << "Scenario" << right << setw(10) << "Frames/s" << setw(10) << "Avg us"
+                 << setw(10) << "Max us" << setw(10) << "Errors" << setw(9) << "Bus-off" << setw(7) << "Load" << endl;
+            for (const auto& scenario : scenarios) {
+                runScenario(scenario, simulatedTime);
+            }
+
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+        }
+    };
+
+    // ========================================
+    // Trace Recording and Replay
+    // ========================================
+
+    class TraceCANDemo {
+    private:
+        // Keeps a 1 Mbit/s bus (8 Mbit/s FD data phase) saturated with a mix of
+        // classic, extended, FD and short frames; returns the wall-clock time
+        // the simulation took
+        static duration<double> runSaturatedBus(steady_clock::duration simulatedTime, TraceRecorder* recorder,
+                                                uint64_t& frames) {
+            auto canBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+            canBus->setBitRate(1000000);
+            canBus->setDataBitRate(8000000);
+            auto node = make_shared<CANNode>(0x01, "Logger Source");
+            canBus->addNode(node);
+            if (recorder) recorder->attach(canBus);
+
+            array<uint8_t, 64> payload{};
+            for (size_t i = 0; i < payload.size(); ++i) {
+                payload[i] = static_cast<uint8_t>(i * 13);
+            }
+            vector<CANMessage> mix = {
+                node->createMessage(0x0C0, span<const uint8_t>(payload.data(), 8)),
+                node->createMessage(0x18FEF100, span<const uint8_t>(payload.data(), 8), CANFormat::EXTENDED),
+                node->createFDMessage(0x200, payload),
+                node->createMessage(0x3A0, span<const uint8_t>(payload.data(), 2)),
+            };
+
+            // A few frames queued at a time, so arbitration cannot starve the
+            // higher IDs of the mix
+            CANBus* bus = canBus.get();
+            uint64_t next = 0;
+            canBus->schedulePeriodic(50us, [bus, &mix, &next] {
+                while (next < bus->getTotalMessages() + 4 && bus->transmitMessage(mix[next % mix.size()])) {
+                    ++next;
+                }
+            });
+
+            auto started = steady_clock::now();
+            canBus->sleepFor(simulatedTime);
+            auto elapsed = steady_clock::now() - started;
+
+            if (recorder) recorder->detach();
+            frames = canBus->getTotalMessages();
+            return elapsed;
+        }
+
+    public:
+        // Records a saturated bus, then reads the trace back as fast as the
+        // mapping allows and replays it into a second bus at the recorded timing
+        static void runRecordReplayDemo(steady_clock::duration simulatedTime = 10s) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    TRACE RECORDING AND REPLAY" << endl;
+            cout << string(60, '=') << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            string path = (filesystem::temp_directory_path() / "can_demo.cantrace").string();
+            cout << fixed << setprecision(2);
+
+            uint64_t plainFrames = 0;
+            auto plainTime = runSaturatedBus(simulatedTime, nullptr, plainFrames);
+
+            uint64_t tracedFrames = 0;
+            duration<double> tracedTime;
+            uint64_t recorded = 0;
+            uint64_t dropped = 0;
+            {
+                TraceRecorder recorder(path);
+                tracedTime = runSaturatedBus(simulatedTime, &recorder, tracedFrames);
+                recorder.close();
+                recorded = recorder.getRecordedFrames();
+                dropped = recorder.getDroppedFrames();
+            }
+
+            double plainCost = plainTime.count() * 1e9 / plainFrames;
+            double tracedCost = tracedTime.count() * 1e9 / tracedFrames;
+            cout << "Simulated bus:   " << plainFrames << " frames, " << plainCost << " ns/frame" << endl;
+            cout << "With recorder:   " << tracedFrames << " frames, " << tracedCost << " ns/frame ("
+                 << recorded << " recorded, " << dropped << " dropped)" << endl;
+            cout << "Recorder cost:   " << max(tracedCost - plainCost, 0.0) << " ns/frame" << endl;
+
+            TraceReader reader(path);
+            array<uint64_t, 4> byKind{};
+            auto started = steady_clock::now();
+            uint64_t read = reader.forEach([&byKind](const CANMessage& message) {
+                byKind[message.fd ? 2 : message.format == CANFormat::EXTENDED ? 1 : message.data.size() == 8 ? 0 : 3]++;
+            });
+            duration<double> readTime = steady_clock::now() - started;
+            cout << "Trace scan:      " << read << " frames in " << readTime.count() * 1000.0 << " ms ("
+                 << read / readTime.count() / 1e6 << " M frames/s)" << endl;
+            cout << "                 classic " << byKind[0] << ", extended " << byKind[1]
+                 << ", FD " << byKind[2] << ", short " << byKind[3] << endl;
+
+            auto replayBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+            replayBus->setBitRate(1000000);
+            replayBus->setDataBitRate(8000000);
+            auto replayStart = replayBus->now();
+            auto replay = reader.replay(replayBus, ReplayTiming::ORIGINAL);
+            while (!replay->isFinished()) {
+                replayBus->sleepFor(100ms);
+            }
+            replayBus->sleepFor(10ms);
+            cout << "Replay:          " << replayBus->getTotalMessages() << " frames over "
+                 << duration<double>(replayBus->now() - replayStart).count() << " s of bus time" << endl;
+            cout << defaultfloat;
+
+            filesystem::remove(path);
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+        }
+    };
+
+    // ========================================
+    // Field Log Import
+    // ========================================
+
+    class LogImportDemo {
+    public:
+        // Imports a candump or Vector ASC capture, lists its busiest IDs and
+        // replays it on a virtual bus at the captured timing
+        static void runLogImportDemo(const string& logPath) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    FIELD LOG IMPORT - " << logPath << endl;
+            cout << string(60, '=') << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            CANLogImporter log(logPath);
+            unordered_map<uint32_t, uint64_t> framesById;
+            auto started = steady_clock::now();
+            LogImportStats stats = log.forEach([&framesById](const CANMessage& message) {
+                framesById[message.id]++;
+            });
+            duration<double> elapsed = steady_clock::now() - started;
+
+            cout << fixed << setprecision(1);
+            cout << (log.getFormat() == CANLogFormat::CANDUMP ? "candump" : "Vector ASC") << " log: "
+                 << stats.frames << " frames, " << stats.skippedLines << " other lines, "
+                 << stats.bytes / 1e6 << " MB in " << elapsed.count() * 1000.0 << " ms ("
+                 << stats.bytes / 1e6 / elapsed.count() << " MB/s)" << endl;
+
+            vector<pair<uint32_t, uint64_t>> busiest(framesById.begin(), framesById.end());
+            sort(busiest.begin(), busiest.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+            busiest.resize(min<size_t>(busiest.size(), 5));
+            for (const auto& [id, frames] : busiest) {
+                cout << "  ID 0x" << hex << uppercase << id << dec << ": " << frames << " frames" << endl;
+            }
+
+            string tracePath = (filesystem::temp_directory_path() / "can_import.cantrace").string();
+            log.convertToTrace(tracePath);
+            {
+                TraceReader trace(tracePath);
+                auto canBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+                canBus->setBitRate(500000);
+                canBus->setDataBitRate(2000000);
+                auto replayStart = canBus->now();
+                auto replay = trace.replay(canBus, ReplayTiming::ORIGINAL);
+                // A capture from a faster bus queues up here; let it drain
+                while (!replay->isFinished() || canBus->getTotalMessages() < replay->getInjectedFrames()) {
+                    canBus->sleepFor(1s);
+                }
+                cout << "Replayed " << canBus->getTotalMessages() << " frames over "
+                     << duration<double>(canBus->now() - replayStart).count() << " s of bus time" << endl;
+            }
+            cout << defaultfloat;
+            filesystem::remove(tracePath);
+
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+        }
+    };
+
+    // ========================================
+    // Batch Signal Decoding
+    // ========================================
+
+    class BatchDecodeDemo {
+    private:
+        static constexpr string_view VEHICLE_DBC = R"(BO_ 768 VEHICLE_STATUS: 8 Vehicle
+ SG_ VehicleSpeed : 0|16@1+ (0.1,0) [0|6553.5] "km/h" Logger
+ SG_ ThrottlePosition : 16|16@1+ (0.01,0) [0|100] "%" Logger
+ SG_ Acceleration : 39|12@0- (0.01,0) [-20.48|20.47] "m/s2" Logger
+)";
+
+        // Minutes of a 100Hz status frame among other traffic, as a trace file
+        static void recordDrive(const string& path, size_t statusFrames) {
+            TraceRecorder recorder(path);
+            mt19937 random(7);
+            array<uint8_t, 8> zeros{};
+            CANMessage status(0x300, zeros);
+            CANMessage other(0x0C0, zeros);
+            double speed = 50.0;
+            for (size_t i = 0; i < statusFrames; ++i) {
+                speed = clamp(speed + (static_cast<int>(random() % 21) - 10) * 0.01, 0.0, 180.0);
+                uint16_t speedRaw = static_cast<uint16_t>(speed * 10);
+                uint16_t throttleRaw = static_cast<uint16_t>(random() % 10001);
+                uint16_t accelRaw = static_cast<uint16_t>(random() % 4096);
+                status.data[0] = static_cast<uint8_t>(speedRaw);
+                status.data[1] = static_cast<uint8_t>(speedRaw >> 8);
+                status.data[2] = static_cast<uint8_t>(throttleRaw);
+                status.data[3] = static_cast<uint8_t>(throttleRaw >> 8);
+                status.data[4] = static_cast<uint8_t>(accelRaw >> 4);       // Motorola, MSB at bit 39
+                status.data[5] = static_cast<uint8_t>((accelRaw & 0x0F) << 4);
+                status.timestamp = steady_clock::time_point(milliseconds(i * 10));
+                recorder.write(status);
+                other.timestamp = status.timestamp + 5ms;
+                recorder.write(other);
+            }
+            recorder.close();
+        }
+
+        template<typename Decode>
+        static double nanosecondsPerFrame(size_t frames, int rounds, Decode&& decode) {
+            auto started = steady_clock::now();
+            for (int round = 0; round < rounds; ++round) decode();
+            return duration<double, nano>(steady_clock::now() - started).count() / (static_cast<double>(frames) * rounds);
+        }
+
+    public:
+        // Pulls one message's frames out of a recorded trace, then decodes a
+        // signal column per frame and with the batch kernels
+        static void runBatchDecodeDemo(size_t statusFrames = 2000000) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    BATCH SIGNAL DECODING" << endl;
+            cout << string(60, '=') << endl;
+
+            string path = (filesystem::temp_directory_path() / "can_batch.cantrace").string();
+            recordDrive(path, statusFrames);
+
+            CANDatabase database = CANDatabase::parse(VEHICLE_DBC);
+            const CANMessageDefinition& definition = database.getMessage("VEHICLE_STATUS");
+            vector<CANMessage> frames;
+            FrameBatch batch;
+            frames.reserve(statusFrames);
+            batch.reserve(statusFrames);
+            {
+                TraceReader trace(path);
+                trace.forEach([&](const CANMessage& message) {
+                    if (message.id != definition.id) return;
+                    frames.push_back(message);
+                    batch.append(message);
+                });
+            }
+            filesystem::remove(path);
+            cout << frames.size() << " VEHICLE_STATUS frames from the trace, best kernel: "
+                 << SignalColumns::backendName(SignalColumns::bestBackend()) << endl;
+
+            using SignalColumns::Backend;
+            constexpr int ROUNDS = 5;
+            vector<double> expected(frames.size());
+            vector<double> column(frames.size());
+            cout << fixed << setprecision(2);
+            for (const CANSignal& signal : definition.signals) {
+                double perFrame = nanosecondsPerFrame(frames.size(), ROUNDS, [&] {
+                    for (size_t i = 0; i < frames.size(); ++i) expected[i] = signal.decode(frames[i]);
+                });
+                cout << signal.name << " (per-frame decode " << perFrame << " ns/frame)" << endl;
+                for (Backend backend : {Backend::SCALAR, Backend::SSE2, Backend::AVX2}) {
+                    if (backend > SignalColumns::bestBackend()) continue;
+                    double batched = nanosecondsPerFrame(frames.size(), ROUNDS, [&] {
+                        signal.decodeColumn(batch, column, backend);
+                    });
+                    bool exact = equal(expected.begin(), expected.end(), column.begin());
+                    cout << "  " << left << setw(7) << SignalColumns::backendName(backend) << right
+                         << setw(6) << batched << " ns/frame  " << setw(5) << perFrame / batched << "x"
+                         << (exact ? "" : "  MISMATCH") << endl;
+                }
+            }
+            cout << defaultfloat;
+        }
+    };
+
+    // ========================================
+    // Frame Latency Under Load
+    // ========================================
+
+    class LatencyDemo {
+    private:
+        static constexpr uint32_t CONTROL_ID = 0x200;           // 20 Hz control frame
+        static constexpr milliseconds CONTROL_PERIOD = 50ms;
+
+        static double toMs(nanoseconds value) { return value.count() / 1e6; }
+
+        // A 20 Hz control frame competing with bursts of higher-priority
+        // traffic that take 'load' of the bus; reports the control frame's
+        // histograms
+        static void runLoadLevel(double load, steady_clock::duration simulatedTime) {
+            auto canBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+            canBus->setBitRate(500000);
+            canBus->setLatencyTracking(true);
+
+            SensorNode control(canBus, 0x10, CONTROL_ID, CONTROL_PERIOD);
+            auto burstNode = make_shared<CANNode>(0x20, "Burst Source");
+            canBus->addNode(burstNode);
+            array<uint8_t, 8> payload{};
+            CANMessage burstFrame = burstNode->createMessage(0x080, payload);
+            constexpr auto BURST_PERIOD = 20ms;
+            size_t burstFrames = static_cast<size_t>(load * BURST_PERIOD / canBus->frameDuration(burstFrame));
+            CANBus* bus = canBus.get();
+            TimerId bursts = canBus->schedulePeriodic(BURST_PERIOD, [bus, burstNode, burstFrames] {
+                array<uint8_t, 8> data{};
+                for (size_t i = 0; i < burstFrames; ++i) {
+                    bus->transmitMessage(burstNode->createMessage(0x080 + static_cast<uint32_t>(i % 16), data));
+                }
+            });
+
+            canBus->sleepFor(simulatedTime);
+            canBus->cancelTimer(bursts);
+            control.stop();
+
+            auto stats = canBus->getLatencyStats(CONTROL_ID).value_or(FrameLatencyStats{});
+            uint64_t expected = static_cast<uint64_t>(simulatedTime / CONTROL_PERIOD);
+            nanoseconds worstCase = stats.queueing.max + stats.transmission.max;
+            bool met = stats.transmission.count + 1 >= expected && worstCase <= CONTROL_PERIOD;
+            cout << setw(5) << static_cast<int>(load * 100) << "%" << setw(7) << canBus->getBusLoad() << "%"
+                 << setw(7) << stats.transmission.count << "/" << expected
+                 << setw(10) << toMs(stats.queueing.percentile(50))
+                 << setw(10) << toMs(stats.queueing.percentile(99))
+                 << setw(10) << toMs(worstCase)
+                 << setw(10) << toMs(stats.interArrival.max)
+                 << setw(10) << toMs(stats.jitter())
+                 << "   " << (met ? "met" : "MISSED") << endl;
+        }
+
+    public:
+        static void runLatencyDemo(steady_clock::duration simulatedTime = 10s) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    CONTROL FRAME LATENCY UNDER LOAD" << endl;
+            cout << string(60, '=') << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            cout << "ID 0x" << hex << CONTROL_ID << dec << " every " << CONTROL_PERIOD.count()
+                 << " ms, deadline = period; times in ms" << endl;
+            cout << setw(6) << "Burst" << setw(8) << "Load" << setw(11) << "Delivered" << setw(10) << "Queue p50" << setw(10) << "p99"
+                 << setw(10) << "Worst" << setw(10) << "Max gap" << setw(10) << "Jitter" << "   Deadline" << endl;
+            cout << fixed << setprecision(2);
+            for (double load : {0.0, 0.3, 0.6, 0.9, 1.2}) {
+                runLoadLevel(load, simulatedTime);
+            }
+            cout << defaultfloat;
+
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+        }
+    };
+
+    // ========================================
+    // Bus Load Sweep
+    // ========================================
+
+    class LoadSweepDemo {
+    private:
+        static double toMs(nanoseconds value) { return value.count() / 1e6; }
+
+        // 20 ECUs with 8 messages each: mostly periodic, some sporadic,
+        // a realistic DLC mix, slight period jitter and occasional bursts
+        static LoadProfile vehicleProfile() {
+            LoadProfile profile;
+            profile.ecuCount = 20;
+            profile.messagesPerEcu = 8;
+            profile.idDistribution = IdDistribution::RATE_MONOTONIC;
+            profile.dlcWeights = {0, 0.05, 0.1, 0, 0.15, 0, 0.1, 0, 0.6};
+            profile.periods = {10ms, 20ms, 50ms, 100ms, 200ms, 500ms, 1000ms};
+            profile.sporadicShare = 0.2;
+            profile.periodJitter = 0.05;
+            profile.burstProbability = 0.05;
+            profile.burstLength = 4;
+            profile.seed = 2024;
+            return profile;
+        }
+
+        // Runs the profile with its rates multiplied by 'scale' and reports
+        // how the highest- and lowest-priority periodic messages fare
+        static void runLoadLevel(LoadProfile profile, double scale, steady_clock::duration simulatedTime) {
+            auto canBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+            canBus->setBitRate(500000);
+            canBus->setLatencyTracking(true);
+
+            profile.rateScale = scale;
+            LoadGenerator generator(canBus, profile);
+            generator.start();
+            canBus->sleepFor(simulatedTime);
+            generator.stop();
+
+            // Periodic messages miss when their worst delivery exceeds the
+            // period or frames went missing
+            const GeneratedMessage* highest = nullptr;
+            const GeneratedMessage* lowest = nullptr;
+            size_t periodic = 0, missed = 0;
+            for (const auto& message : generator.getMessages()) {
+                if (message.sporadic) continue;
+                ++periodic;
+                if (!highest || message.id < highest->id) highest = &message;
+                if (!lowest || message.id > lowest->id) lowest = &message;
+
+                auto stats = canBus->getLatencyStats(message.id);
+                uint64_t expected = static_cast<uint64_t>(simulatedTime / message.period);
+                bool met = expected == 0 || (stats && stats->transmission.count + 1 >= expected
+                        && stats->queueing.max + stats->transmission.max <= message.period);
+                if (!met) ++missed;
+            }
+            auto p99 = [&](const GeneratedMessage* message) {
+                auto stats = message ? canBus->getLatencyStats(message->id) : nullopt;
+                if (!stats) return string("starved");
+                ostringstream text;
+                text << fixed << setprecision(2) << toMs(stats->queueing.percentile(99));
+                return text.str();
+            };
+
+            auto generated = generator.getStats();
+            cout << setw(7) << static_cast<int>(generator.offeredLoad() * 100 + 0.5) << "%"
+                 << setw(7) << canBus->getBusLoad() << "%"
+                 << setw(10) << generated.framesSent << setw(10) << generated.framesRejected
+                 << setw(12) << p99(highest) << setw(12) << p99(lowest)
+                 << setw(11) << missed << "/" << periodic << endl;
+        }
+
+    public:
+        static void runLoadSweepDemo(steady_clock::duration simulatedTime = 10s) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    BUS LOAD SWEEP - WHERE LATENCY COLLAPSES" << endl;
+            cout << string(60, '=') << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            LoadProfile profile = vehicleProfile();
+            double baseLoad;
+            {
+                auto sizingBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+                sizingBus->setBitRate(500000);
+                LoadGenerator sizing(sizingBus, profile);
+                baseLoad = sizing.offeredLoad();
+            }
+            cout << profile.ecuCount << " ECUs x " << profile.messagesPerEcu << " messages at 500 kbit/s, "
+                 << "nominal offered load " << fixed << setprecision(1) << baseLoad * 100 << "%" << endl;
+            cout << "Queueing p99 in ms of the highest- and lowest-priority periodic message" << endl;
+            cout << setw(8) << "Offered" << setw(8) << "Load" << setw(10) << "Sent" << setw(10) << "Rejected"
+                 << setw(12) << "Top p99" << setw(12) << "Bottom p99" << setw(15) << "Deadline miss" << endl;
+            cout << defaultfloat;
+            for (double target : {0.2, 0.4, 0.6, 0.8, 0.9, 1.0, 1.1}) {
+                runLoadLevel(profile, target / baseLoad, simulatedTime);
+            }
+
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+        }
+    };
+
+    // ========================================
+    // CAN FD Throughput
+    // ========================================
+
+    class CANFDDemo {
+    private:
+        struct ThroughputResult {
+            uint64_t frames = 0;
+            double payloadBitsPerSecond = 0.0;
+        };
+
+        // Keeps one sender's transmit ring full for 'simulatedTime' of virtual
+        // bus time, so the bus never idles between frames
+        static ThroughputResult measureSaturated(const CANMessage& frame, uint32_t nominalRate,
+                                                 uint32_t dataRate, steady_clock::duration simulatedTime) {
+            auto canBus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME);
+            canBus->setBitRate(nominalRate);
+            canBus->setDataBitRate(dataRate);
+            canBus->setStuffBitModel(StuffBitModel::EXACT);
+            canBus->addNode(make_shared<CANNode>(0x01, "Sender"));
+            canBus->addNode(make_shared<CANNode>(0x02, "Receiver"));
+
+            CANBus* bus = canBus.get();
+            canBus->schedulePeriodic(1ms, [bus, frame] {
+                while (bus->transmitMessage(frame)) {}
+            });
+            canBus->sleepFor(simulatedTime);
+
+            ThroughputResult result;
+            result.frames = canBus->getTotalMessages();
+            result.payloadBitsPerSecond = result.frames * frame.data.size() * 8.0
+                                        / duration<double>(simulatedTime).count();
+            return result;
+        }
+
+    public:
+        // Classic 8-byte frames at 500 kbit/s against 64-byte FD frames with
+        // the data phase at 1-8 Mbit/s, all with the same arbitration rate
+        static void runThroughputComparison(steady_clock::duration simulatedTime = 1s) {
+            cout << "\n" << string(60, '=') << endl;
+            cout << "    CAN FD THROUGHPUT - CLASSIC vs FD DATA PHASE RATES" << endl;
+            cout << string(60, '=') << endl;
+
+            LogLevel previousLevel = Logger::instance().getLevel();
+            Logger::instance().setLevel(LogLevel::WARNING);
+
+            constexpr uint32_t nominalRate = 500000;
+            array<uint8_t, 64> payload{};
+            for (size_t i = 0; i < payload.size(); ++i) {
+                payload[i] = static_cast<uint8_t>(i * 37);
+            }
+
+            struct Configuration {
+                string name;
+                CANMessage frame;
+                uint32_t dataRate;
+            };
+            vector<Configuration> configurations = {
+                {"Classic 8B", CANMessage(0x100, span<const uint8_t>(payload.data(), 8)), 0},
+                {"FD 64B, no BRS", CANMessage::makeFD(0x100, payload, CANFormat::STANDARD, false), 0},
+                {"FD 64B @ 1 Mbps", CANMessage::makeFD(0x100, payload), 1000000},
+                {"FD 64B @ 2 Mbps", CANMessage::makeFD(0x100, payload), 2000000},
+                {"FD 64B @ 5 Mbps", CANMessage::makeFD(0x100, payload), 5000000},
+                {"FD 64B @ 8 Mbps", CANMessage::makeFD(0x100, payload), 8000000},
+            };
+
+            cout << left << setw(18) << "Frame" << right << setw(10) << "Bits"
+                 << setw(12) << "Frames/s" << setw(14) << "Payload kb/s" << setw(12) << "Efficiency" << "  vs classic" << endl;
+
+            double classicRate = 0.0;
+            for (const auto& config : configurations) {
+                ThroughputResult result = measureSaturated(config.frame, nominalRate, config.dataRate, simulatedTime);
+                CANPhaseBits bits = CANFrameCodec::phaseBits(config.frame);
+                if (classicRate == 0.0) classicRate = result.payloadBitsPerSecond;
+
+                // Share of the frame's bits that are payload
+                double efficiency = config.frame.data.size() * 8.0 / (bits.nominal + bits.data);
+
+                cout << left << setw(18) << config.name << right
+                     << setw(6) << bits.nominal << "+" << setw(3) << bits.data
+                     << setw(12) << static_cast<uint64_t>(result.frames / duration<double>(simulatedTime).count())
+                     << setw(14) << fixed << setprecision(1) << result.payloadBitsPerSecond / 1000.0
+                     << setw(11) << setprecision(1) << efficiency * 100.0 << "%"
+                     << "  x" << setprecision(2) << result.payloadBitsPerSecond / classicRate << endl;
+            }
+            cout << defaultfloat;
+
+            Logger::instance().flush();
+            Logger::instance().setLevel(previousLevel);
+        }
+    };
+
     // ========================================
     // Interactive CAN Bus Learning
     // ========================================
@@ -355,15 +1124,11 @@ export namespace CANDemo {
     
     class HeadlightControlDemo {
     private:
-        static constexpr uint32_t HEADLIGHT_COMMAND_ID = 0x200;
-        static constexpr uint32_t HEADLIGHT_STATUS_ID = 0x201;
-        static constexpr uint32_t USER_INPUT_ID = 0x202;
-
-        enum class HeadlightState {
-            OFF = 0,
-            ON = 1,
-            AUTO = 2
-        };
+        // Message IDs and payloads are the HeadlightControl module's
+        using HeadlightState = HeadlightControl::HeadlightState;
+        using UserInput = HeadlightControl::UserInput;
+        using HeadlightCommand = HeadlightControl::HeadlightCommand;
+        using HeadlightStatus = HeadlightControl::HeadlightStatus;
 
     public:
         static void runHeadlightDemo() {
@@ -440,8 +1205,7 @@ export namespace CANDemo {
         }
 
         static void sendUserCommand(shared_ptr<CANBus> canBus, HeadlightState command) {
-            vector<uint8_t> data = {static_cast<uint8_t>(command)};
-            CANMessage msg(USER_INPUT_ID, data);
+            CANMessage msg(UserInput::Layout::id, UserInput::Layout::encode({command}));
             
             canBus->transmitMessage(msg);
             
@@ -460,8 +1224,7 @@ export namespace CANDemo {
             cout << "[ECU] *** Processing command..." << endl;
             
             // ECU processes the user input and sends control command
-            vector<uint8_t> data = {static_cast<uint8_t>(command), 0xFF}; // Command validation flag
-            CANMessage msg(HEADLIGHT_COMMAND_ID, data);
+            CANMessage msg(HeadlightCommand::Layout::id, HeadlightCommand::Layout::encode({command}));
             
             canBus->transmitMessage(msg);
             cout << "[ECU] >>> Sending control command to headlight controller (CAN ID: 0x" 
@@ -498,12 +1261,7 @@ export namespace CANDemo {
         }
 
         static void sendStatusFeedback(shared_ptr<CANBus> canBus, HeadlightState mode, bool lightState) {
-            vector<uint8_t> data = {
-                static_cast<uint8_t>(mode),
-                static_cast<uint8_t>(lightState ? 1 : 0),
-                0xAA  // Status validation flag
-            };
-            CANMessage msg(HEADLIGHT_STATUS_ID, data);
+            CANMessage msg(HeadlightStatus::Layout::id, HeadlightStatus::Layout::encode({mode, lightState}));
             
             canBus->transmitMessage(msg);
             cout << "[HEADLIGHT_CTRL] <<< Status update sent (CAN ID: 0x" 
@@ -515,8 +1273,44 @@ export namespace CANDemo {
         AutomotiveCANDemo::runEngineManagementDemo();
     }
 
-    void runIndustrialDemo() {
-        IndustrialCANDemo::runFactoryAutomationDemo();
+    void runIndustrialDemo(TimeMode timeMode = TimeMode::REAL_TIME) {
+        IndustrialCANDemo::runFactoryAutomationDemo(timeMode);
+    }
+
+    void runFleetDemo(size_t vehicleCount = 100) {
+        FleetCANDemo::runFleetDemo(vehicleCount);
+    }
+
+    void runGatewayDemo() {
+        GatewayCANDemo::runGatewayDemo();
+    }
+
+    void runErrorStormDemo() {
+        ErrorConfinementDemo::runErrorStormDemo();
+    }
+
+    void runTraceDemo() {
+        TraceCANDemo::runRecordReplayDemo();
+    }
+
+    void runLogImportDemo(const string& logPath) {
+        LogImportDemo::runLogImportDemo(logPath);
+    }
+
+    void runBatchDecodeDemo() {
+        BatchDecodeDemo::runBatchDecodeDemo();
+    }
+
+    void runLatencyDemo() {
+        LatencyDemo::runLatencyDemo();
+    }
+
+    void runLoadSweepDemo() {
+        LoadSweepDemo::runLoadSweepDemo();
+    }
+
+    void runCANFDDemo() {
+        CANFDDemo::runThroughputComparison();
     }
 
     void runHeadlightDemo() {
@@ -0,0 +1,397 @@
+// CANCoroutines.ixx - Coroutine-Based Node API
+// Node logic written as C++20 coroutines that suspend on bus events (frame
+// reception, transmit queue space, bus time) instead of blocking a thread.
+// Coroutines are resumed by the bus timer wheel: on the runUntil() caller in
+// virtual-time mode (a pool worker when the bus belongs to a FleetSimulation)
+// and on the bus thread in real-time mode.
+
+module;
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <optional>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+
+export module CANCoroutines;
+
+import CANBusSimulation;
+
+using namespace std;
+using namespace std::chrono;
+
+export namespace CANSim {
+
+    // ========================================
+    // Coroutine Task
+    // ========================================
+
+    // Lazily started coroutine returned by node logic. A task is either
+    // spawned on a CoroutineNode, which owns it, or awaited by another task,
+    // which resumes when it finishes and receives its exception.
+    class CANTask {
+    public:
+        struct promise_type {
+            coroutine_handle<> continuation;    // awaiting task, if any
+            exception_ptr error;
+
+            CANTask get_return_object() {
+                return CANTask(coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            suspend_always initial_suspend() noexcept { return {}; }
+
+            // Hands control straight back to the awaiting task (symmetric
+            // transfer), so deep co_await chains do not grow the stack
+            auto final_suspend() noexcept {
+                struct FinalAwaiter {
+                    bool await_ready() noexcept { return false; }
+                    coroutine_handle<> await_suspend(coroutine_handle<promise_type> handle) noexcept {
+                        auto next = handle.promise().continuation;
+                        return next ? next : noop_coroutine();
+                    }
+                    void await_resume() noexcept {}
+                };
+                return FinalAwaiter{};
+            }
+
+            void return_void() {}
+
+            void unhandled_exception() {
+                error = current_exception();
+                if (continuation) return;      // rethrown in the awaiting task
+
+                try {
+                    rethrow_exception(error);
+                } catch (const exception& e) {
+                    logError(LogTag::APP, "Coroutine task failed: {}", e.what());
+                } catch (...) {
+                    logError(LogTag::APP, "Coroutine task failed with an unknown exception");
+                }
+            }
+        };
+
+    private:
+        friend class CoroutineNode;
+
+        coroutine_handle<promise_type> handle;
+
+        explicit CANTask(coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+
+    public:
+        CANTask(CANTask&& other) noexcept : handle(exchange(other.handle, {})) {}
+
+        CANTask& operator=(CANTask&& other) noexcept {
+            if (this != &other) {
+                if (handle) handle.destroy();
+                handle = exchange(other.handle, {});
+            }
+            return *this;
+        }
+
+        CANTask(const CANTask&) = delete;
+        CANTask& operator=(const CANTask&) = delete;
+
+        ~CANTask() {
+            if (handle) handle.destroy();
+        }
+
+        bool done() const { return !handle || handle.done(); }
+
+        // co_await task: runs the child inside the awaiting task
+        auto operator co_await() const noexcept {
+            struct Awaiter {
+                coroutine_handle<promise_type> child;
+
+                bool await_ready() const noexcept { return !child || child.done(); }
+
+                coroutine_handle<> await_suspend(coroutine_handle<> parent) noexcept {
+                    child.promise().continuation = parent;
+                    return child;
+                }
+
+                void await_resume() const {
+                    if (child && child.promise().error) {
+                        rethrow_exception(child.promise().error);
+                    }
+                }
+            };
+            return Awaiter{handle};
+        }
+    };
+
+    // ========================================
+    // Coroutine Node
+    // ========================================
+
+    // A bus node whose behavior is a set of coroutines:
+    //
+    //     CANTask heartbeat(CoroutineNode& node) {
+    //         auto next = node.now();
+    //         while (true) {
+    //             co_await node.transmit(node.createMessage(0x700, {0x05}));
+    //             co_await node.sleepUntil(next += 100ms);
+    //         }
+    //     }
+    //     node.spawn(heartbeat(node));
+    //
+    // All coroutines of a node run on the bus's timer thread, one at a time,
+    // so node state needs no locking. A frame wakes every coroutine waiting
+    // for its ID when it arrives; frames nobody is waiting for are dropped,
+    // as with a controller that has no receive FIFO.
+    class CoroutineNode {
+    private:
+        struct ReceiveState {
+            uint32_t canId;
+            CANMessage message{};
+            bool received = false;
+            coroutine_handle<> handle{};
+            uint64_t timeoutKey = 0;           // pending timeout, if any
+        };
+
+        shared_ptr<CANBus> canBus;
+        shared_ptr<CANNode> canNode;
+        vector<CANTask> tasks;
+
+        // Resumptions are bus timers, keyed so the destructor can cancel them
+        mutex stateMutex;
+        unordered_map<uint64_t, TimerId> pendingTimers;
+        uint64_t nextTimerKey = 1;
+        bool closing = false;
+        vector<ReceiveState*> receivers;      // scheduler thread only
+
+        // Runs an action on the scheduler thread at 'when'; returns a key for cancelPosted()
+        uint64_t post(steady_clock::time_point when, function<void()> action) {
+            uint64_t key;
+            {
+                lock_guard<mutex> lock(stateMutex);
+                if (closing) return 0;
+                key = nextTimerKey++;
+                pendingTimers.emplace(key, 0);
+            }
+
+            // Registered before scheduling: the timer may fire before scheduleAt returns
+            TimerId id = canBus->scheduleAt(when, [this, key, action = std::move(action)] {
+                {
+                    lock_guard<mutex> lock(stateMutex);
+                    if (closing || !pendingTimers.contains(key)) return;
+                }
+                action();
+                // Erased only now, so the destructor still waits for this timer
+                lock_guard<mutex> lock(stateMutex);
+                pendingTimers.erase(key);
+            });
+
+            lock_guard<mutex> lock(stateMutex);
+            auto it = pendingTimers.find(key);
+            if (it != pendingTimers.end()) it->second = id;
+            return key;
+        }
+
+        void cancelPosted(uint64_t key) {
+            TimerId id = 0;
+            {
+                lock_guard<mutex> lock(stateMutex);
+                auto it = pendingTimers.find(key);
+                if (it == pendingTimers.end()) return;
+                id = it->second;
+                pendingTimers.erase(it);
+            }
+            if (id != 0) canBus->cancelTimer(id);
+        }
+
+        void resumeAt(steady_clock::time_point when, coroutine_handle<> handle) {
+            post(when, [handle] { handle.resume(); });
+        }
+
+        // Message handler (runs under the bus topology lock): wakes the waiters
+        // through the timer wheel so their code runs outside the lock
+        void deliver(const CANMessage& message) {
+            auto now = canBus->now();
+            for (size_t i = 0; i < receivers.size();) {
+                ReceiveState* state = receivers[i];
+                if (state->canId != message.id) {
+                    ++i;
+                    continue;
+                }
+                state->message = message;
+                state->received = true;
+                if (state->timeoutKey != 0) {
+                    cancelPosted(state->timeoutKey);
+                }
+                receivers[i] = receivers.back();
+                receivers.pop_back();
+                resumeAt(now, state->handle);
+            }
+        }
+
+        void removeReceiver(ReceiveState* state) {
+            receivers.erase(remove(receivers.begin(), receivers.end(), state), receivers.end());
+        }
+
+        // Retries a transmission every frame time until the ring has room
+        void retryTransmit(const CANMessage* message, bool* accepted, coroutine_handle<> handle) {
+            *accepted = canBus->transmitMessage(*message);
+            if (*accepted || !canBus->isActive()) {
+                handle.resume();
+                return;
+            }
+            post(canBus->now() + canBus->frameDuration(*message), [this, message, accepted, handle] {
+                retryTransmit(message, accepted, handle);
+            });
+        }
+
+    public:
+        // ========================================
+        // Awaitables
+        // ========================================
+
+        struct SleepAwaiter {
+            CoroutineNode* node;
+            steady_clock::time_point when;
+
+            bool await_ready() const { return when <= node->now(); }
+            void await_suspend(coroutine_handle<> handle) { node->resumeAt(when, handle); }
+            void await_resume() const noexcept {}
+        };
+
+        // Resumes with the frame, or nullopt when the timeout expires first
+        struct ReceiveAwaiter {
+            CoroutineNode* node;
+            optional<steady_clock::time_point> deadline;
+            ReceiveState state;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(coroutine_handle<> handle) {
+                state.handle = handle;
+                node->receivers.push_back(&state);
+                if (deadline) {
+                    state.timeoutKey = node->post(*deadline, [this] {
+                        node->removeReceiver(&state);
+                        state.handle.resume();
+                    });
+                }
+            }
+
+            optional<CANMessage> await_resume() const {
+                if (!state.received) return nullopt;
+                return state.message;
+            }
+        };
+
+        // Resumes once the frame is queued for arbitration; true unless the
+        // bus shut down first
+        struct TransmitAwaiter {
+            CoroutineNode* node;
+            CANMessage message;
+            bool accepted = false;
+
+            bool await_ready() {
+                accepted = node->canBus->transmitMessage(message);
+                return accepted || !node->canBus->isActive();
+            }
+
+            void await_suspend(coroutine_handle<> handle) {
+                node->post(node->now() + node->canBus->frameDuration(message), [this, handle] {
+                    node->retryTransmit(&message, &accepted, handle);
+                });
+            }
+
+            bool await_resume() const noexcept { return accepted; }
+        };
+
+        CoroutineNode(shared_ptr<CANBus> bus, uint32_t nodeId, const string& name)
+            : canBus(std::move(bus)) {
+            canNode = make_shared<CANNode>(nodeId, name);
+            canNode->setMessageHandler([this](const CANMessage& message) {
+                deliver(message);
+            });
+            canBus->addNode(canNode);
+        }
+
+        // Detaches from the bus, waits for a resumption running on another
+        // thread, then destroys the coroutines wherever they are suspended
+        ~CoroutineNode() {
+            canBus->removeNode(canNode->getId());
+
+            unordered_map<uint64_t, TimerId> pending;
+            {
+                lock_guard<mutex> lock(stateMutex);
+                closing = true;
+                pending.swap(pendingTimers);
+            }
+            for (auto& [key, id] : pending) {
+                if (id != 0) canBus->cancelTimer(id);
+            }
+            receivers.clear();
+            tasks.clear();
+        }
+
+        CoroutineNode(const CoroutineNode&) = delete;
+        CoroutineNode& operator=(const CoroutineNode&) = delete;
+
+        // Takes ownership of a task and starts it on the scheduler thread
+        void spawn(CANTask task) {
+            coroutine_handle<> handle = task.handle;
+            {
+                lock_guard<mutex> lock(stateMutex);
+                tasks.push_back(std::move(task));
+            }
+            post(now(), [this, handle] {
+                // Reclaim finished tasks here, where no task is being resumed
+                {
+                    lock_guard<mutex> lock(stateMutex);
+                    tasks.erase(remove_if(tasks.begin(), tasks.end(), [handle](const CANTask& t) {
+                        return t.done() && t.handle != handle;
+                    }), tasks.end());
+                }
+                handle.resume();
+            });
+        }
+
+        SleepAwaiter sleepUntil(steady_clock::time_point when) { return {this, when}; }
+        SleepAwaiter sleepFor(steady_clock::duration duration) { return {this, now() + duration}; }
+
+        // Waits for the next frame with this ID. Add a matching acceptance
+        // filter to the node, or it only hears IDs it accepts by default.
+        ReceiveAwaiter receive(uint32_t canId) {
+            return {this, nullopt, ReceiveState{canId}};
+        }
+
+        ReceiveAwaiter receive(uint32_t canId, steady_clock::duration timeout) {
+            return {this, now() + timeout, ReceiveState{canId}};
+        }
+
+        TransmitAwaiter transmit(const CANMessage& message) { return {this, message}; }
+
+        template<typename Data>
+        CANMessage createMessage(uint32_t canId, const Data& data,
+                                 CANFormat format = CANFormat::STANDARD) {
+            return canNode->createMessage(canId, data, format);
+        }
+
+        CANMessage createMessage(uint32_t canId, initializer_list<uint8_t> data,
+                                 CANFormat format = CANFormat::STANDARD) {
+            return canNode->createMessage(canId, data, format);
+        }
+
+        steady_clock::time_point now() const { return canBus->now(); }
+        shared_ptr<CANNode> getNode() const { return canNode; }
+        shared_ptr<CANBus> getBus() const { return canBus; }
+
+        size_t getTaskCount() {
+            lock_guard<mutex> lock(stateMutex);
+            return tasks.size();
+        }
+    };
+
+} // namespace CANSim
@@ -0,0 +1,1192 @@
+// CANDatabase.ixx - DBC Message and Signal Catalog
+// Loads Vector DBC files into a catalog of messages and signals. Each
+// signal picks its extraction routine once at load time (byte order, sign,
+// alignment, value type), so decoding a frame is a table of indirect calls
+// with no per-call lookups or branching on signal metadata.
+// Messages known at build time can instead use the compile-time layouts at
+// the end of this module: typed structs whose codecs are fully unrolled.
+// For offline analysis, CANSignal::decodeColumn decodes one signal from a
+// run of frames with AVX2/SSE2 kernels.
+
+module;
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <map>
+#include <optional>
+#include <span>
+#include <charconv>
+#include <stdexcept>
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <utility>
+#include <array>
+#include <tuple>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CANSIM_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// AVX2 kernels are compiled for AVX2 alone and chosen at run time, so the
+// rest of the build keeps its baseline instruction set
+#if defined(CANSIM_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CANSIM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CANSIM_TARGET_AVX2
+#endif
+
+export module CANDatabase;
+
+import CANBusSimulation;
+
+using namespace std;
+
+export namespace CANSim {
+
+    // ========================================
+    // Signal Extraction
+    // ========================================
+
+    enum class SignalByteOrder {
+        INTEL = 0,      // @1: little-endian, start bit is the LSB
+        MOTOROLA = 1    // @0: big-endian, start bit is the MSB
+    };
+
+    enum class SignalValueType {
+        INTEGER = 0,
+        FLOAT32 = 1,    // SIG_VALTYPE_ 1
+        FLOAT64 = 2     // SIG_VALTYPE_ 2
+    };
+
+    // Where a signal sits, precomputed for its extraction routine. Routines
+    // load a 64-bit window at 'byteOffset' and shift/mask it. The window may
+    // run past the frame's bytes: CANPayload always holds 64 bytes, and
+    // FrameBatch pads its buffer so the last frame's window stays inside it.
+    struct SignalLayout {
+        uint16_t startBit = 0;          // DBC start bit
+        uint8_t length = 0;             // bits
+        uint8_t byteOffset = 0;         // first byte of the 64-bit window
+        uint8_t shift = 0;              // window shift that moves the LSB to bit 0
+        uint8_t signShift = 0;          // 64 - length
+        uint64_t mask = 0;
+    };
+
+    // Raw (unscaled) signal value from a 64-byte payload buffer
+    using SignalExtractor = double (*)(const uint8_t* payload, const SignalLayout& layout);
+
+    namespace SignalExtractors {
+
+        inline uint64_t byteSwap(uint64_t value) {
+            value = ((value & 0x00FF00FF00FF00FFull) << 8) | ((value >> 8) & 0x00FF00FF00FF00FFull);
+            value = ((value & 0x0000FFFF0000FFFFull) << 16) | ((value >> 16) & 0x0000FFFF0000FFFFull);
+            return (value << 32) | (value >> 32);
+        }
+
+        inline uint64_t loadLittle(const uint8_t* bytes) {
+            uint64_t value;
+            memcpy(&value, bytes, sizeof(value));
+            if constexpr (endian::native == endian::big) value = byteSwap(value);
+            return value;
+        }
+
+        inline uint64_t loadBig(const uint8_t* bytes) {
+            uint64_t value;
+            memcpy(&value, bytes, sizeof(value));
+            if constexpr (endian::native == endian::little) value = byteSwap(value);
+            return value;
+        }
+
+        inline int64_t signExtend(uint64_t raw, const SignalLayout& layout) {
+            return static_cast<int64_t>(raw << layout.signShift) >> layout.signShift;
+        }
+
+        // Byte-aligned 8/16/32-bit Intel signals: one load
+        template<typename T>
+        double intelAligned(const uint8_t* payload, const SignalLayout& layout) {
+            make_unsigned_t<T> raw = 0;
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                raw |= static_cast<make_unsigned_t<T>>(payload[layout.byteOffset + i]) << (8 * i);
+            }
+            return static_cast<double>(static_cast<T>(raw));
+        }
+
+        // Byte-aligned 8/16/32-bit Motorola signals (MSB at bit 7 of its byte)
+        template<typename T>
+        double motorolaAligned(const uint8_t* payload, const SignalLayout& layout) {
+            make_unsigned_t<T> raw = 0;
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                raw = static_cast<make_unsigned_t<T>>((raw << 8) | payload[layout.byteOffset + i]);
+            }
+            return static_cast<double>(static_cast<T>(raw));
+        }
+
+        // Any signal inside one 64-bit window
+        template<SignalByteOrder order>
+        uint64_t windowBits(const uint8_t* payload, const SignalLayout& layout) {
+            uint64_t window = order == SignalByteOrder::INTEL
+                ? loadLittle(payload + layout.byteOffset) : loadBig(payload + layout.byteOffset);
+            return (window >> layout.shift) & layout.mask;
+        }
+
+        // Signals that straddle a 64-bit window (long and unaligned): bit by bit
+        template<SignalByteOrder order>
+        uint64_t wideBits(const uint8_t* payload, const SignalLayout& layout) {
+            uint64_t raw = 0;
+            if constexpr (order == SignalByteOrder::INTEL) {
+                for (unsigned i = layout.length; i-- > 0;) {
+                    unsigned position = layout.startBit + i;
+                    raw = (raw << 1) | ((payload[position / 8] >> (position % 8)) & 1u);
+                }
+            } else {
+                unsigned msb = (layout.startBit / 8) * 8 + (7 - layout.startBit % 8);
+                for (unsigned i = 0; i < layout.length; ++i) {
+                    unsigned position = msb + i;                        // big-endian bit order
+                    raw = (raw << 1) | ((payload[position / 8] >> (7 - position % 8)) & 1u);
+                }
+            }
+            return raw;
+        }
+
+        template<SignalByteOrder order, bool isSigned, bool wide>
+        double integer(const uint8_t* payload, const SignalLayout& layout) {
+            uint64_t raw = wide ? wideBits<order>(payload, layout) : windowBits<order>(payload, layout);
+            if constexpr (isSigned) {
+                return static_cast<double>(signExtend(raw, layout));
+            } else {
+                return static_cast<double>(raw);
+            }
+        }
+
+        template<SignalByteOrder order, typename Float, bool wide>
+        double floating(const uint8_t* payload, const SignalLayout& layout) {
+            uint64_t raw = wide ? wideBits<order>(payload, layout) : windowBits<order>(payload, layout);
+            if constexpr (sizeof(Float) == 4) {
+                return static_cast<double>(bit_cast<float>(static_cast<uint32_t>(raw)));
+            } else {
+                return bit_cast<double>(raw);
+            }
+        }
+    }
+
+    // ========================================
+    // Batch Column Decoding
+    // ========================================
+
+    // One signal decoded from a run of frames: per lane, the frame's 64-bit
+    // window is loaded (gathered when frames are far apart), byte-reversed
+    // with shuffles for Motorola, shifted, masked and turned into a double by
+    // exponent splicing (raw | 2^52 as bits, minus 2^52), so there are no
+    // per-frame calls or branches. Covers integer signals of up to 52 bits
+    // inside one window, which doubles hold exactly.
+    namespace SignalColumns {
+
+        enum class Backend {
+            SCALAR = 0,     // per-frame extractor calls
+            SSE2 = 1,       // 2 lanes, baseline on x86-64
+            AVX2 = 2        // 4 lanes
+        };
+
+        struct ColumnLayout {
+            bool vectorizable = false;
+            bool bigEndian = false;
+            uint8_t byteOffset = 0;     // window start in the payload; 0 for signals in the first 8 bytes
+            uint8_t shift = 0;
+            uint64_t mask = 0;
+            uint64_t signFlip = 0;      // sign bit of signed signals: (raw ^ flip) - flip sign-extends
+        };
+
+        constexpr uint64_t EXPONENT_2_52 = 0x4330000000000000ull;   // bits of 2^52
+        constexpr double TWO_52 = 4503599627370496.0;
+
+        inline bool cpuHasAvx2() {
+#if defined(CANSIM_SIMD_X86) && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) return false;
+            __cpuid(info, 1);
+            bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+            __cpuidex(info, 7, 0);
+            return osSavesYmm && (info[1] & (1 << 5));
+#elif defined(CANSIM_SIMD_X86)
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        }
+
+        inline Backend bestBackend() {
+#ifdef CANSIM_SIMD_X86
+            static const Backend best = cpuHasAvx2() ? Backend::AVX2 : Backend::SSE2;
+            return best;
+#else
+            return Backend::SCALAR;
+#endif
+        }
+
+        inline string_view backendName(Backend backend) {
+            switch (backend) {
+                case Backend::AVX2: return "AVX2";
+                case Backend::SSE2: return "SSE2";
+                default: return "scalar";
+            }
+        }
+
+        // Same arithmetic as the vector lanes, for tails
+        template<bool bigEndian>
+        double decodeOne(const uint8_t* payload, const ColumnLayout& column, double bias, double factor, double offset) {
+            const uint8_t* window = payload + column.byteOffset;
+            uint64_t bits = bigEndian ? SignalExtractors::loadBig(window) : SignalExtractors::loadLittle(window);
+            uint64_t raw = (bits >> column.shift) & column.mask;
+            return (bit_cast<double>((raw ^ column.signFlip) | EXPONENT_2_52) - bias) * factor + offset;
+        }
+
+#ifdef CANSIM_SIMD_X86
+        // Frames 'stride' bytes apart, starting at the first frame's payload.
+        // Packed 8-byte payloads (FrameBatch) are read with plain vector loads.
+        template<bool bigEndian>
+        void decodeSse2(const uint8_t* payload, size_t stride, size_t count, const ColumnLayout& column,
+                        double factor, double offset, double* values) {
+            const double bias = TWO_52 + static_cast<double>(column.signFlip);
+            const __m128i shift = _mm_cvtsi32_si128(column.shift);
+            const __m128i mask = _mm_set1_epi64x(static_cast<long long>(column.mask));
+            const __m128i flip = _mm_set1_epi64x(static_cast<long long>(column.signFlip));
+            const __m128i exponent = _mm_set1_epi64x(static_cast<long long>(EXPONENT_2_52));
+            const __m128d biasLanes = _mm_set1_pd(bias);
+            const __m128d scale = _mm_set1_pd(factor);
+            const __m128d move = _mm_set1_pd(offset);
+            const bool packed = stride == 8;
+
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) {
+                const uint8_t* window = payload + i * stride + column.byteOffset;
+                __m128i raw;
+                if (packed) {
+                    raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(window));
+                } else {
+                    raw = _mm_set_epi64x(static_cast<long long>(SignalExtractors::loadLittle(window + stride)),
+                                         static_cast<long long>(SignalExtractors::loadLittle(window)));
+                }
+                if constexpr (bigEndian) {
+                    // Swap the bytes of each 16-bit word, then reverse the words
+                    raw = _mm_or_si128(_mm_slli_epi16(raw, 8), _mm_srli_epi16(raw, 8));
+                    raw = _mm_shufflehi_epi16(_mm_shufflelo_epi16(raw, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+                }
+                raw = _mm_and_si128(_mm_srl_epi64(raw, shift), mask);
+                raw = _mm_or_si128(_mm_xor_si128(raw, flip), exponent);
+                __m128d value = _mm_sub_pd(_mm_castsi128_pd(raw), biasLanes);
+                _mm_storeu_pd(values + i, _mm_add_pd(_mm_mul_pd(value, scale), move));
+            }
+            for (; i < count; ++i) {
+                values[i] = decodeOne<bigEndian>(payload + i * stride, column, bias, factor, offset);
+            }
+        }
+
+        template<bool bigEndian>
+        CANSIM_TARGET_AVX2 void decodeAvx2(const uint8_t* payload, size_t stride, size_t count, const ColumnLayout& column,
+                                           double factor, double offset, double* values) {
+            const double bias = TWO_52 + static_cast<double>(column.signFlip);
+            const long long step = static_cast<long long>(stride);
+            const __m256i lanes = _mm256_set_epi64x(3 * step, 2 * step, step, 0);
+            const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                     7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+            const __m128i shift = _mm_cvtsi32_si128(column.shift);
+            const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(column.mask));
+            const __m256i flip = _mm256_set1_epi64x(static_cast<long long>(column.signFlip));
+            const __m256i exponent = _mm256_set1_epi64x(static_cast<long long>(EXPONENT_2_52));
+            const __m256d biasLanes = _mm256_set1_pd(bias);
+            const __m256d scale = _mm256_set1_pd(factor);
+            const __m256d move = _mm256_set1_pd(offset);
+            const bool packed = stride == 8;
+
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const uint8_t* window = payload + i * stride + column.byteOffset;
+                __m256i raw = packed
+                    ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(window))
+                    : _mm256_i64gather_epi64(reinterpret_cast<const long long*>(window), lanes, 1);
+                if constexpr (bigEndian) raw = _mm256_shuffle_epi8(raw, reverse);
+                raw = _mm256_and_si256(_mm256_srl_epi64(raw, shift), mask);
+                raw = _mm256_or_si256(_mm256_xor_si256(raw, flip), exponent);
+                __m256d value = _mm256_sub_pd(_mm256_castsi256_pd(raw), biasLanes);
+                _mm256_storeu_pd(values + i, _mm256_add_pd(_mm256_mul_pd(value, scale), move));
+            }
+            for (; i < count; ++i) {
+                values[i] = decodeOne<bigEndian>(payload + i * stride, column, bias, factor, offset);
+            }
+        }
+#endif
+    }
+
+    // Payloads of many frames of one message, packed back to back for
+    // column decoding: 8 bytes per frame for classic CAN, 64 for CAN FD.
+    // Far denser than CANMessage, so a column pass streams a fraction of
+    // the memory. Longer frames are cut to the stride; the rest is zeroed.
+    class FrameBatch {
+    private:
+        // Zeroed bytes after the last frame: the largest distance a 64-bit
+        // signal window can reach past the end of its frame
+        static constexpr size_t WINDOW_PADDING = 8;
+
+        size_t stride;
+        vector<uint8_t> payloads;
+        vector<uint8_t> lengths;
+        uint8_t shortest = CANFD_MAX_DATA_LENGTH;
+
+    public:
+        explicit FrameBatch(size_t payloadBytes = CAN_MAX_DATA_LENGTH)
+            : stride(payloadBytes <= CAN_MAX_DATA_LENGTH ? CAN_MAX_DATA_LENGTH : CANFD_MAX_DATA_LENGTH) {
+            if (payloadBytes > CANFD_MAX_DATA_LENGTH) throw invalid_argument("Frame payloads are at most 64 bytes");
+        }
+
+        void reserve(size_t frames) {
+            payloads.reserve(frames * stride + WINDOW_PADDING);
+            lengths.reserve(frames);
+        }
+
+        void append(const CANMessage& message) {
+            size_t length = min(message.data.size(), stride);
+            size_t at = lengths.size() * stride;
+            payloads.resize(at + stride + WINDOW_PADDING);
+            memcpy(payloads.data() + at, message.data.data(), length);
+            lengths.push_back(static_cast<uint8_t>(length));
+            shortest = min(shortest, static_cast<uint8_t>(length));
+        }
+
+        void clear() {
+            payloads.clear();
+            lengths.clear();
+            shortest = CANFD_MAX_DATA_LENGTH;
+        }
+
+        size_t size() const { return lengths.size(); }
+        size_t getStride() const { return stride; }
+        const uint8_t* data() const { return payloads.data(); }
+        uint8_t getLength(size_t index) const { return lengths[index]; }
+        uint8_t getShortest() const { return shortest; }
+    };
+
+    // ========================================
+    // Signals and Messages
+    // ========================================
+
+    class CANSignal {
+    private:
+        friend class CANDatabase;
+
+        SignalLayout layout;
+        SignalExtractor extractor = nullptr;
+        size_t requiredBytes = 0;       // payload bytes the signal reaches into
+        SignalColumns::ColumnLayout column;
+
+        // Picks the cheapest routine that is exact for this signal
+        void compile() {
+            using namespace SignalExtractors;
+            const unsigned length = layout.length;
+            layout.mask = length == 64 ? ~0ull : (1ull << length) - 1;
+            layout.signShift = static_cast<uint8_t>(64 - length);
+
+            unsigned lowestBit;         // LSB position inside the window (from its MSB for Motorola)
+            bool wide;
+            if (byteOrder == SignalByteOrder::INTEL) {
+                unsigned lastBit = layout.startBit + length - 1;
+                requiredBytes = lastBit / 8 + 1;
+                layout.byteOffset = static_cast<uint8_t>(min<unsigned>(layout.startBit / 8, 56));
+                lowestBit = layout.startBit - layout.byteOffset * 8;
+                wide = lowestBit + length > 64;
+                layout.shift = static_cast<uint8_t>(lowestBit);
+            } else {
+                unsigned msb = (layout.startBit / 8) * 8 + (7 - layout.startBit % 8);
+                unsigned lsb = msb + length - 1;
+                requiredBytes = lsb / 8 + 1;
+                layout.byteOffset = static_cast<uint8_t>(min<unsigned>(layout.startBit / 8, 56));
+                lowestBit = lsb - layout.byteOffset * 8;
+                wide = lowestBit > 63;
+                layout.shift = static_cast<uint8_t>(wide ? 0 : 63 - lowestBit);
+            }
+            if (requiredBytes > CANFD_MAX_DATA_LENGTH) {
+                throw runtime_error("Signal " + name + " extends past 64 bytes");
+            }
+
+            column = {};
+            if (valueType == SignalValueType::INTEGER && !wide && length <= 52) {
+                // Classic-sized signals read the payload's first 8 bytes, so
+                // packed 8-byte batches never read past a frame
+                unsigned base = requiredBytes <= CAN_MAX_DATA_LENGTH ? 0 : layout.byteOffset;
+                column.vectorizable = true;
+                bool intelOrder = byteOrder == SignalByteOrder::INTEL;
+                column.bigEndian = !intelOrder;
+                column.byteOffset = static_cast<uint8_t>(base);
+                column.shift = static_cast<uint8_t>(layout.shift + (intelOrder ? 8 : -8) * static_cast<int>(layout.byteOffset - base));
+                column.mask = layout.mask;
+                column.signFlip = isSigned ? 1ull << (length - 1) : 0;
+            }
+
+            bool intel = byteOrder == SignalByteOrder::INTEL;
+            if (valueType != SignalValueType::INTEGER) {
+                bool single = valueType == SignalValueType::FLOAT32;
+                if (length != (single ? 32u : 64u)) {
+                    throw runtime_error("Float signal " + name + " must be " + (single ? "32" : "64") + " bits");
+                }
+                if (single) {
+                    extractor = intel ? (wide ? floating<SignalByteOrder::INTEL, float, true> : floating<SignalByteOrder::INTEL, float, false>)
+                                      : (wide ? floating<SignalByteOrder::MOTOROLA, float, true> : floating<SignalByteOrder::MOTOROLA, float, false>);
+                } else {
+                    extractor = intel ? (wide ? floating<SignalByteOrder::INTEL, double, true> : floating<SignalByteOrder::INTEL, double, false>)
+                                      : (wide ? floating<SignalByteOrder::MOTOROLA, double, true> : floating<SignalByteOrder::MOTOROLA, double, false>);
+                }
+                return;
+            }
+
+            // Whole bytes, 8/16/32 bits: direct loads
+            bool aligned = intel ? layout.startBit % 8 == 0 : layout.startBit % 8 == 7;
+            if (aligned && (length == 8 || length == 16 || length == 32)) {
+                layout.byteOffset = static_cast<uint8_t>(layout.startBit / 8);
+                if (length == 8) {
+                    extractor = isSigned ? intelAligned<int8_t> : intelAligned<uint8_t>;
+                } else if (length == 16) {
+                    extractor = intel ? (isSigned ? intelAligned<int16_t> : intelAligned<uint16_t>)
+                                      : (isSigned ? motorolaAligned<int16_t> : motorolaAligned<uint16_t>);
+                } else {
+                    extractor = intel ? (isSigned ? intelAligned<int32_t> : intelAligned<uint32_t>)
+                                      : (isSigned ? motorolaAligned<int32_t> : motorolaAligned<uint32_t>);
+                }
+                return;
+            }
+
+            if (intel) {
+                extractor = isSigned ? (wide ? integer<SignalByteOrder::INTEL, true, true> : integer<SignalByteOrder::INTEL, true, false>)
+                                     : (wide ? integer<SignalByteOrder::INTEL, false, true> : integer<SignalByteOrder::INTEL, false, false>);
+            } else {
+                extractor = isSigned ? (wide ? integer<SignalByteOrder::MOTOROLA, true, true> : integer<SignalByteOrder::MOTOROLA, true, false>)
+                                     : (wide ? integer<SignalByteOrder::MOTOROLA, false, true> : integer<SignalByteOrder::MOTOROLA, false, false>);
+            }
+        }
+
+        void checkColumn(size_t frames, span<double> values) const {
+            if (values.size() < frames) {
+                throw invalid_argument("Value column for " + name + " needs " + to_string(frames) + " entries");
+            }
+        }
+
+        void decodeStrided(const uint8_t* payload, size_t stride, size_t count, double* values,
+                           SignalColumns::Backend backend) const {
+            using namespace SignalColumns;
+            backend = column.vectorizable ? min(backend, bestBackend()) : Backend::SCALAR;
+            switch (backend) {
+#ifdef CANSIM_SIMD_X86
+                case Backend::AVX2:
+                    (column.bigEndian ? decodeAvx2<true> : decodeAvx2<false>)(payload, stride, count, column, factor, offset, values);
+                    break;
+                case Backend::SSE2:
+                    (column.bigEndian ? decodeSse2<true> : decodeSse2<false>)(payload, stride, count, column, factor, offset, values);
+                    break;
+#endif
+                default:
+                    for (size_t i = 0; i < count; ++i) {
+                        values[i] = extractor(payload + i * stride, layout) * factor + offset;
+                    }
+                    break;
+            }
+        }
+
+    public:
+        string name;
+        SignalByteOrder byteOrder = SignalByteOrder::INTEL;
+        SignalValueType valueType = SignalValueType::INTEGER;
+        bool isSigned = false;
+        double factor = 1.0;
+        double offset = 0.0;
+        double minimum = 0.0;
+        double maximum = 0.0;
+        string unit;
+        vector<string> receivers;
+        bool isMultiplexer = false;             // "M": selects the multiplexed signals
+        optional<int64_t> multiplexValue;       // "m<n>": present only when the multiplexer is n
+        map<int64_t, string> valueDescriptions; // VAL_ entries
+
+        uint16_t getStartBit() const { return layout.startBit; }
+        uint8_t getLength() const { return layout.length; }
+        size_t getRequiredBytes() const { return requiredBytes; }
+
+        // Value before factor/offset. The frame must carry getRequiredBytes().
+        double decodeRaw(const CANMessage& message) const {
+            return extractor(message.data.data(), layout);
+        }
+
+        // Physical value: raw * factor + offset
+        double decode(const CANMessage& message) const {
+            return extractor(message.data.data(), layout) * factor + offset;
+        }
+
+        // Physical values of this signal from a run of frames of its message,
+        // into values[i]. Vectorized when the signal allows (see
+        // SignalColumns); 'backend' is capped at what the CPU supports.
+        // Multiplexing is not applied; frames too short for the signal give NaN.
+        void decodeColumn(const FrameBatch& batch, span<double> values,
+                          SignalColumns::Backend backend = SignalColumns::bestBackend()) const {
+            checkColumn(batch.size(), values);
+            if (requiredBytes > batch.getStride()) {
+                fill_n(values.begin(), batch.size(), numeric_limits<double>::quiet_NaN());
+                return;
+            }
+            decodeStrided(batch.data(), batch.getStride(), batch.size(), values.data(), backend);
+            if (batch.getShortest() < requiredBytes) {
+                constexpr double missing = numeric_limits<double>::quiet_NaN();
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    values[i] = batch.getLength(i) < requiredBytes ? missing : values[i];
+                }
+            }
+        }
+
+        // Same, straight from frames (gathers across whole CANMessages)
+        void decodeColumn(span<const CANMessage> frames, span<double> values,
+                          SignalColumns::Backend backend = SignalColumns::bestBackend()) const {
+            checkColumn(frames.size(), values);
+            constexpr size_t BLOCK = 1024;     // short-frame fixups while the block is still in cache
+            for (size_t start = 0; start < frames.size(); start += BLOCK) {
+                size_t count = min(BLOCK, frames.size() - start);
+                double* out = values.data() + start;
+                decodeStrided(frames[start].data.data(), sizeof(CANMessage), count, out, backend);
+                for (size_t i = 0; i < count; ++i) {
+                    if (frames[start + i].data.size() < requiredBytes) out[i] = numeric_limits<double>::quiet_NaN();
+                }
+            }
+        }
+
+        // VAL_ text for the frame's raw value, or empty
+        string_view describe(const CANMessage& message) const {
+            auto it = valueDescriptions.find(static_cast<int64_t>(decodeRaw(message)));
+            return it == valueDescriptions.end() ? string_view() : string_view(it->second);
+        }
+    };
+
+    class CANMessageDefinition {
+    private:
+        friend class CANDatabase;
+
+        optional<size_t> multiplexerIndex;
+
+    public:
+        uint32_t id = 0;
+        CANFormat format = CANFormat::STANDARD;
+        string name;
+        uint8_t length = 0;             // bytes, as declared
+        string transmitter;
+        vector<CANSignal> signals;
+
+        // Index into 'signals' (resolve once, then decode by index)
+        size_t signalIndex(string_view signalName) const {
+            for (size_t i = 0; i < signals.size(); ++i) {
+                if (signals[i].name == signalName) return i;
+            }
+            throw invalid_argument("Message " + name + " has no signal " + string(signalName));
+        }
+
+        const CANSignal& getSignal(string_view signalName) const {
+            return signals[signalIndex(signalName)];
+        }
+
+        // Decodes every signal into values[i] (physical units). Signals the
+        // frame is too short for, or whose multiplexer value does not match,
+        // are NaN.
+        void decode(const CANMessage& message, span<double> values) const {
+            if (values.size() < signals.size()) {
+                throw invalid_argument("Value buffer for " + name + " needs " + to_string(signals.size()) + " entries");
+            }
+            constexpr double missing = numeric_limits<double>::quiet_NaN();
+            size_t available = message.data.size();
+            for (size_t i = 0; i < signals.size(); ++i) {
+                const CANSignal& signal = signals[i];
+                values[i] = available >= signal.getRequiredBytes() ? signal.decode(message) : missing;
+            }
+            if (multiplexerIndex) {
+                double selector = signals[*multiplexerIndex].decodeRaw(message);
+                for (size_t i = 0; i < signals.size(); ++i) {
+                    const auto& selectedBy = signals[i].multiplexValue;
+                    if (selectedBy && static_cast<double>(*selectedBy) != selector) values[i] = missing;
+                }
+            }
+        }
+    };
+
+    // ========================================
+    // DBC Database
+    // ========================================
+
+    // Messages and signals of a DBC file. Understands BO_, SG_ (including
+    // multiplexing), VAL_ and SIG_VALTYPE_; other statements (comments,
+    // attributes, node lists, ...) are skipped. Errors name the DBC line.
+    //
+    //     auto database = CANDatabase::loadFile("vehicle.dbc");
+    //     const auto& status = database.getMessage("VEHICLE_STATUS");
+    //     size_t speed = status.signalIndex("VehicleSpeed");
+    //     ... status.signals[speed].decode(frame) ...
+    class CANDatabase {
+    private:
+        static constexpr uint32_t DBC_EXTENDED_FLAG = 0x80000000;
+        static constexpr uint32_t INDEPENDENT_SIGNALS_ID = 0xC0000000;  // VECTOR__INDEPENDENT_SIG_MSG
+
+        vector<CANMessageDefinition> messages;
+        unordered_map<uint64_t, size_t> messagesById;
+        unordered_map<string, size_t> messagesByName;
+
+        static uint64_t idKey(uint32_t id, CANFormat format) {
+            return (static_cast<uint64_t>(format == CANFormat::EXTENDED) << 32) | id;
+        }
+
+        // Cursor over one DBC statement
+        class Parser {
+        private:
+            string_view text;
+            size_t position = 0;
+            size_t line;
+
+        public:
+            Parser(string_view statement, size_t lineNumber) : text(statement), line(lineNumber) {}
+
+            [[noreturn]] void fail(const string& what) const {
+                throw runtime_error("DBC line " + to_string(line) + ": " + what);
+            }
+
+            void skipSpaces() {
+                while (position < text.size() && (text[position] == ' ' || text[position] == '\t' ||
+                                                  text[position] == '\r' || text[position] == '\n')) {
+                    ++position;
+                }
+            }
+
+            bool atEnd() {
+                skipSpaces();
+                return position >= text.size();
+            }
+
+            bool accept(char c) {
+                skipSpaces();
+                if (position < text.size() && text[position] == c) {
+                    ++position;
+                    return true;
+                }
+                return false;
+            }
+
+            void expect(char c) {
+                if (!accept(c)) fail(string("expected '") + c + "'");
+            }
+
+            string_view identifier() {
+                skipSpaces();
+                size_t start = position;
+                while (position < text.size() && (isalnum(static_cast<unsigned char>(text[position])) || text[position] == '_')) {
+                    ++position;
+                }
+                if (start == position) fail("expected a name");
+                return text.substr(start, position - start);
+            }
+
+            template<typename T>
+            T number() {
+                skipSpaces();
+                size_t start = position;
+                if (position < text.size() && text[position] == '+') ++position;
+                T value{};
+                auto [end, error] = from_chars(text.data() + position, text.data() + text.size(), value);
+                if (error != errc()) {
+                    position = start;
+                    fail("expected a number");
+                }
+                position = static_cast<size_t>(end - text.data());
+                return value;
+            }
+
+            string quoted() {
+                skipSpaces();
+                if (position >= text.size() || text[position] != '"') fail("expected a string");
+                size_t end = text.find('"', position + 1);
+                if (end == string_view::npos) fail("unterminated string");
+                string value(text.substr(position + 1, end - position - 1));
+                position = end + 1;
+                return value;
+            }
+
+            // Comma-separated names up to the end of the statement
+            vector<string> nameList() {
+                vector<string> names;
+                while (!atEnd()) {
+                    names.emplace_back(identifier());
+                    accept(',');
+                }
+                return names;
+            }
+        };
+
+        CANMessageDefinition* currentMessage = nullptr;     // while parsing: last BO_
+
+        CANMessageDefinition* findMutable(uint32_t dbcId) {
+            auto it = messagesById.find(idKey(dbcId & ~DBC_EXTENDED_FLAG,
+                                              (dbcId & DBC_EXTENDED_FLAG) ? CANFormat::EXTENDED : CANFormat::STANDARD));
+            return it == messagesById.end() ? nullptr : &messages[it->second];
+        }
+
+        CANSignal* findSignal(Parser& parser, uint32_t dbcId, string_view signalName) {
+            CANMessageDefinition* message = findMutable(dbcId);
+            if (!message) return nullptr;       // e.g. VECTOR__INDEPENDENT_SIG_MSG
+            for (auto& signal : message->signals) {
+                if (signal.name == signalName) return &signal;
+            }
+            parser.fail("unknown signal " + string(signalName));
+        }
+
+        // BO_ <id> <name>: <length> <transmitter>
+        void parseMessage(Parser& parser) {
+            uint32_t dbcId = parser.number<uint32_t>();
+            string_view name = parser.identifier();
+            parser.expect(':');
+            unsigned length = parser.number<unsigned>();
+            string_view transmitter = parser.atEnd() ? string_view() : parser.identifier();
+
+            currentMessage = nullptr;
+            if (dbcId == INDEPENDENT_SIGNALS_ID) return;
+
+            CANMessageDefinition message;
+            message.format = (dbcId & DBC_EXTENDED_FLAG) ? CANFormat::EXTENDED : CANFormat::STANDARD;
+            message.id = dbcId & ~DBC_EXTENDED_FLAG;
+            if (message.id > (message.format == CANFormat::EXTENDED ? CAN_MAX_EXTENDED_ID : CAN_MAX_STANDARD_ID)) {
+                parser.fail("invalid CAN ID " + to_string(message.id));
+            }
+            if (length > CANFD_MAX_DATA_LENGTH) parser.fail("message length above 64 bytes");
+            message.name = string(name);
+            message.length = static_cast<uint8_t>(length);
+            message.transmitter = string(transmitter);
+
+            uint64_t key = idKey(message.id, message.format);
+            if (messagesById.contains(key)) parser.fail("duplicate message ID " + to_string(message.id));
+            messagesById.emplace(key, messages.size());
+            messagesByName.emplace(message.name, messages.size());
+            messages.push_back(std::move(message));
+            currentMessage = &messages.back();
+        }
+
+        // SG_ <name> [M|m<n>] : <start>|<length>@<order><sign> (<factor>,<offset>) [<min>|<max>] "<unit>" <receivers>
+        void parseSignal(Parser& parser) {
+            CANSignal signal;
+            signal.name = string(parser.identifier());
+            if (!parser.accept(':')) {
+                string_view multiplexing = parser.identifier();
+                if (multiplexing == "M") {
+                    signal.isMultiplexer = true;
+                } else if (multiplexing.size() > 1 && multiplexing[0] == 'm') {
+                    int64_t value = 0;
+                    auto [end, error] = from_chars(multiplexing.data() + 1, multiplexing.data() + multiplexing.size(), value);
+                    if (error != errc()) parser.fail("invalid multiplex indicator");
+                    signal.multiplexValue = value;
+                    signal.isMultiplexer = end != multiplexing.data() + multiplexing.size() && *end == 'M';
+                } else {
+                    parser.fail("invalid multiplex indicator");
+                }
+                parser.expect(':');
+            }
+
+            unsigned startBit = parser.number<unsigned>();
+            parser.expect('|');
+            unsigned length = parser.number<unsigned>();
+            parser.expect('@');
+            unsigned order = parser.number<unsigned>();
+            if (parser.accept('-')) {
+                signal.isSigned = true;
+            } else {
+                parser.expect('+');
+            }
+            parser.expect('(');
+            signal.factor = parser.number<double>();
+            parser.expect(',');
+            signal.offset = parser.number<double>();
+            parser.expect(')');
+            parser.expect('[');
+            signal.minimum = parser.number<double>();
+            parser.expect('|');
+            signal.maximum = parser.number<double>();
+            parser.expect(']');
+            signal.unit = parser.quoted();
+            signal.receivers = parser.nameList();
+
+            if (order > 1) parser.fail("byte order must be 0 or 1");
+            if (length == 0 || length > 64) parser.fail("signal length must be 1-64 bits");
+            if (startBit >= CANFD_MAX_DATA_LENGTH * 8) parser.fail("start bit beyond 64 bytes");
+            signal.byteOrder = order == 1 ? SignalByteOrder::INTEL : SignalByteOrder::MOTOROLA;
+            signal.layout.startBit = static_cast<uint16_t>(startBit);
+            signal.layout.length = static_cast<uint8_t>(length);
+
+            if (!currentMessage) return;
+            try {
+                signal.compile();
+            } catch (const runtime_error& e) {
+                parser.fail(e.what());
+            }
+            if (signal.isMultiplexer) {
+                currentMessage->multiplexerIndex = currentMessage->signals.size();
+            }
+            currentMessage->signals.push_back(std::move(signal));
+        }
+
+        // VAL_ <id> <signal> <value> "<text>" ... ;
+        void parseValueDescriptions(Parser& parser) {
+            uint32_t dbcId = parser.number<uint32_t>();
+            string_view signalName = parser.identifier();
+            CANSignal* signal = findSignal(parser, dbcId, signalName);
+            while (!parser.accept(';')) {
+                auto value = static_cast<int64_t>(parser.number<double>());
+                string text = parser.quoted();
+                if (signal) signal->valueDescriptions[value] = std::move(text);
+            }
+        }
+
+        // SIG_VALTYPE_ <id> <signal> : <0|1|2> ;
+        void parseValueType(Parser& parser) {
+            uint32_t dbcId = parser.number<uint32_t>();
+            string_view signalName = parser.identifier();
+            parser.accept(':');
+            unsigned type = parser.number<unsigned>();
+            if (type > 2) parser.fail("signal value type must be 0, 1 or 2");
+            CANSignal* signal = findSignal(parser, dbcId, signalName);
+            if (!signal) return;
+            signal->valueType = static_cast<SignalValueType>(type);
+            try {
+                signal->compile();
+            } catch (const runtime_error& e) {
+                parser.fail(e.what());
+            }
+        }
+
+        // Statements without a terminating ';'
+        static bool isLineStatement(string_view keyword) {
+            return keyword == "BO_" || keyword == "SG_" || keyword == "VERSION" || keyword == "BS_" ||
+                   keyword == "BU_" || keyword == "NS_";
+        }
+
+        // Whether 'text' has a ';' outside quotes
+        static bool hasTerminator(string_view text) {
+            bool inString = false;
+            for (char c : text) {
+                if (c == '"') inString = !inString;
+                else if (c == ';' && !inString) return true;
+            }
+            return false;
+        }
+
+        void parseText(string_view text) {
+            size_t lineNumber = 0;
+            size_t position = 0;
+            bool inSymbolList = false;      // NS_ block: indented lines until a blank line
+
+            while (position < text.size()) {
+                size_t lineEnd = text.find('\n', position);
+                if (lineEnd == string_view::npos) lineEnd = text.size();
+                string_view line = text.substr(position, lineEnd - position);
+                size_t statementLine = ++lineNumber;
+                position = lineEnd + 1;
+
+                size_t first = line.find_first_not_of(" \t\r");
+                if (first == string_view::npos) {
+                    inSymbolList = false;
+                    continue;
+                }
+                if (inSymbolList && first > 0) continue;
+                inSymbolList = false;
+
+                string_view trimmed = line.substr(first);
+                string_view keyword = trimmed.substr(0, trimmed.find_first_of(" \t\r:"));
+
+                if (isLineStatement(keyword)) {
+                    Parser parser(trimmed.substr(keyword.size()), statementLine);
+                    if (keyword == "BO_") parseMessage(parser);
+                    else if (keyword == "SG_") parseSignal(parser);
+                    else if (keyword == "NS_") inSymbolList = true;
+                    continue;
+                }
+
+                // ';'-terminated statement, possibly over several lines
+                size_t statementStart = position - line.size() - 1 + first;
+                size_t statementEnd = lineEnd;
+                while (!hasTerminator(text.substr(statementStart, statementEnd - statementStart)) && statementEnd < text.size()) {
+                    statementEnd = text.find('\n', statementEnd + 1);
+                    if (statementEnd == string_view::npos) statementEnd = text.size();
+                    ++lineNumber;
+                }
+                position = statementEnd + 1;
+
+                Parser parser(text.substr(statementStart + keyword.size(), statementEnd - statementStart - keyword.size()), statementLine);
+                if (keyword == "VAL_") parseValueDescriptions(parser);
+                else if (keyword == "SIG_VALTYPE_") parseValueType(parser);
+            }
+            currentMessage = nullptr;
+        }
+
+    public:
+        CANDatabase() = default;
+
+        // Parses DBC text; throws runtime_error naming the offending line
+        static CANDatabase parse(string_view text) {
+            CANDatabase database;
+            database.parseText(text);
+            return database;
+        }
+
+        static CANDatabase loadFile(const string& path) {
+            ifstream file(path, ios::binary);
+            if (!file) throw runtime_error("Cannot open DBC file: " + path);
+            stringstream contents;
+            contents << file.rdbuf();
+            return parse(contents.str());
+        }
+
+        CANDatabase(CANDatabase&&) = default;
+        CANDatabase& operator=(CANDatabase&&) = default;
+        CANDatabase(const CANDatabase&) = delete;
+        CANDatabase& operator=(const CANDatabase&) = delete;
+
+        const vector<CANMessageDefinition>& getMessages() const { return messages; }
+
+        const CANMessageDefinition* findMessage(uint32_t id, CANFormat format = CANFormat::STANDARD) const {
+            auto it = messagesById.find(idKey(id, format));
+            return it == messagesById.end() ? nullptr : &messages[it->second];
+        }
+
+        const CANMessageDefinition* findMessage(const CANMessage& message) const {
+            return findMessage(message.id, message.format);
+        }
+
+        const CANMessageDefinition& getMessage(string_view name) const {
+            auto it = messagesByName.find(string(name));
+            if (it == messagesByName.end()) throw invalid_argument("DBC has no message " + string(name));
+            return messages[it->second];
+        }
+    };
+
+    // ========================================
+    // Compile-Time Message Layouts
+    // ========================================
+
+    // A signal fixed at compile time and bound to a member of a message
+    // struct. Byte span, per-byte masks and shifts are constants, so encode
+    // and decode unroll into one mask-and-shift per touched byte, with no
+    // loops or branches left at run time. Scaled values are rounded and
+    // clamped to the raw range; unscaled integers and enums are truncated
+    // to the field width.
+    template<auto Member, uint16_t StartBit, uint8_t Length, double Factor = 1.0, double Offset = 0.0,
+             SignalByteOrder Order = SignalByteOrder::INTEL, bool Signed = false>
+    class SignalField {
+    private:
+        template<typename> struct MemberOf;
+        template<typename O, typename V> struct MemberOf<V O::*> {
+            using owner = O;
+            using value = V;
+        };
+
+        using Value = typename MemberOf<decltype(Member)>::value;
+
+        static constexpr bool intel = Order == SignalByteOrder::INTEL;
+        static constexpr unsigned msb = (StartBit / 8) * 8 + (7 - StartBit % 8);   // big-endian bit order
+        static constexpr uint64_t rawMask = Length == 64 ? ~0ull : (1ull << Length) - 1;
+        static constexpr bool unitScale = Factor == 1.0 && Offset == 0.0;
+
+        static_assert(Length >= 1 && Length <= 64, "Signal length must be 1-64 bits");
+        static_assert(is_arithmetic_v<Value> || is_enum_v<Value>, "Signals bind arithmetic or enum members");
+        static_assert((unitScale && !is_floating_point_v<Value>) || Length <= 53,
+                      "Scaled signals must fit a double's mantissa");
+        static_assert(Factor != 0.0, "Signal factor must be non-zero");
+
+    public:
+        using Owner = typename MemberOf<decltype(Member)>::owner;
+
+        static constexpr unsigned firstByte = intel ? StartBit / 8 : msb / 8;
+        static constexpr unsigned lastByte = intel ? (StartBit + Length - 1) / 8 : (msb + Length - 1) / 8;
+        static constexpr size_t requiredBytes = lastByte + 1;
+
+        static_assert(requiredBytes <= CANFD_MAX_DATA_LENGTH, "Signal extends past 64 bytes");
+
+        // Bits of payload byte 'index' this signal occupies
+        static constexpr uint8_t occupiedBits(unsigned index) {
+            uint8_t bits = 0;
+            for (unsigned i = 0; i < Length; ++i) {
+                unsigned position = intel ? StartBit + i : msb + i;
+                if (position / 8 != index) continue;
+                bits |= static_cast<uint8_t>(1u << (intel ? position % 8 : 7 - position % 8));
+            }
+            return bits;
+        }
+
+    private:
+        static constexpr size_t byteCount = lastByte - firstByte + 1;
+
+        // Left shift that moves a payload byte's bits to their place in the raw value
+        static constexpr int byteShift(unsigned index) {
+            return intel ? static_cast<int>(index * 8) - StartBit
+                         : static_cast<int>(msb + Length - 1) - static_cast<int>(index * 8 + 7);
+        }
+
+        static constexpr auto masks = [] {
+            array<uint8_t, byteCount> table{};
+            for (size_t i = 0; i < byteCount; ++i) table[i] = occupiedBits(firstByte + i);
+            return table;
+        }();
+
+        static constexpr auto shifts = [] {
+            array<int, byteCount> table{};
+            for (size_t i = 0; i < byteCount; ++i) table[i] = byteShift(firstByte + i);
+            return table;
+        }();
+
+        static constexpr uint64_t place(uint64_t bits, int shift) {
+            return shift >= 0 ? bits << shift : bits >> -shift;
+        }
+
+        template<size_t... I>
+        static constexpr uint64_t gather(const uint8_t* payload, index_sequence<I...>) {
+            return (place(payload[firstByte + I] & masks[I], shifts[I]) | ...);
+        }
+
+        template<size_t... I>
+        static constexpr void scatter(uint8_t* payload, uint64_t raw, index_sequence<I...>) {
+            ((payload[firstByte + I] = static_cast<uint8_t>(
+                (payload[firstByte + I] & ~masks[I]) | (place(raw, -shifts[I]) & masks[I]))), ...);
+        }
+
+        static constexpr int64_t roundToInteger(double value) {
+            return static_cast<int64_t>(value < 0.0 ? value - 0.5 : value + 0.5);
+        }
+
+        static constexpr uint64_t toRaw(Value value) {
+            if constexpr (unitScale && !is_floating_point_v<Value>) {
+                return static_cast<uint64_t>(value) & rawMask;
+            } else {
+                constexpr double lowest = Signed ? -static_cast<double>(rawMask / 2) - 1.0 : 0.0;
+                constexpr double highest = Signed ? static_cast<double>(rawMask / 2) : static_cast<double>(rawMask);
+                double scaled = (static_cast<double>(value) - Offset) * (1.0 / Factor);
+                scaled = scaled != scaled ? 0.0 : clamp(scaled, lowest, highest);     // NaN encodes as 0
+                return static_cast<uint64_t>(roundToInteger(scaled)) & rawMask;
+            }
+        }
+
+        static constexpr Value fromRaw(uint64_t raw) {
+            constexpr unsigned signShift = 64 - Length;
+            if constexpr (unitScale && !is_floating_point_v<Value>) {
+                if constexpr (Signed) return static_cast<Value>(static_cast<int64_t>(raw << signShift) >> signShift);
+                else return static_cast<Value>(raw);
+            } else {
+                double physical = (Signed ? static_cast<double>(static_cast<int64_t>(raw << signShift) >> signShift)
+                                          : static_cast<double>(raw)) * Factor + Offset;
+                if constexpr (is_floating_point_v<Value>) return static_cast<Value>(physical);
+                else return static_cast<Value>(roundToInteger(physical));
+            }
+        }
+
+    public:
+        static constexpr void encode(const Owner& message, uint8_t* payload) {
+            scatter(payload, toRaw(message.*Member), make_index_sequence<byteCount>());
+        }
+
+        static constexpr void decode(const uint8_t* payload, Owner& message) {
+            message.*Member = fromRaw(gather(payload, make_index_sequence<byteCount>()));
+        }
+
+        // True if a DBC signal has the same bits, byte order and scaling
+        static bool matches(const CANSignal& signal) {
+            return signal.getStartBit() == StartBit && signal.getLength() == Length &&
+                   signal.byteOrder == Order && signal.isSigned == Signed &&
+                   signal.valueType == SignalValueType::INTEGER &&
+                   signal.factor == Factor && signal.offset == Offset;
+        }
+    };
+
+    // A message struct's wire layout: its ID, length in bytes and the
+    // SignalFields that bind its members. Overlapping signals, signals past
+    // the length and fields of different structs fail to compile.
+    template<uint32_t Id, size_t Length, typename... Fields>
+    class MessageLayout {
+    private:
+        static_assert(sizeof...(Fields) > 0, "A message layout needs at least one signal");
+
+        static constexpr bool disjoint() {
+            array<uint8_t, CANFD_MAX_DATA_LENGTH> used{};
+            bool clash = false;
+            auto claim = [&](auto field) {
+                for (unsigned i = 0; i < used.size(); ++i) {
+                    uint8_t bits = decltype(field)::type::occupiedBits(i);
+                    clash = clash || (used[i] & bits) != 0;
+                    used[i] |= bits;
+                }
+            };
+            (claim(type_identity<Fields>()), ...);
+            return !clash;
+        }
+
+    public:
+        using Message = typename tuple_element_t<0, tuple<Fields...>>::Owner;
+
+        static constexpr uint32_t id = Id;
+        static constexpr size_t length = Length;
+        static constexpr size_t requiredBytes = max({Fields::requiredBytes...});
+
+        static_assert(Length <= CANFD_MAX_DATA_LENGTH, "Message length exceeds 64 bytes");
+        static_assert((is_same_v<typename Fields::Owner, Message> && ...), "Signals must bind members of one struct");
+        static_assert(requiredBytes <= Length, "Signal extends past the message length");
+        static_assert(disjoint(), "Signals overlap");
+
+        // Unused bits are zero
+        static constexpr array<uint8_t, Length> encode(const Message& message) {
+            array<uint8_t, Length> payload{};
+            (Fields::encode(message, payload.data()), ...);
+            return payload;
+        }
+
+        static constexpr Message decode(const array<uint8_t, Length>& payload) {
+            Message message{};
+            (Fields::decode(payload.data(), message), ...);
+            return message;
+        }
+
+        // False, leaving 'message' untouched, if the frame is too short
+        static bool decode(const CANMessage& frame, Message& message) {
+            if (frame.data.size() < requiredBytes) return false;
+            (Fields::decode(frame.data.data(), message), ...);
+            return true;
+        }
+
+        // True if 'definition' has this ID and length and one matching
+        // signal per field, in field order
+        static bool matches(const CANMessageDefinition& definition) {
+            if (definition.id != Id || definition.length != Length || definition.signals.size() != sizeof...(Fields)) {
+                return false;
+            }
+            size_t index = 0;
+            return (Fields::matches(definition.signals[index++]) && ...);
+        }
+    };
+
+    // Checks a DBC against the layouts of the structs built from it, for
+    // code that decodes the same messages both ways
+    template<typename... Layouts>
+    bool layoutsMatch(const CANDatabase& database) {
+        auto matches = [&database](auto layout) {
+            using Layout = typename decltype(layout)::type;
+            const CANMessageDefinition* definition = database.findMessage(Layout::id);
+            return definition && Layout::matches(*definition);
+        };
+        return (matches(type_identity<Layouts>()) && ...);
+    }
+
+} // namespace CANSim
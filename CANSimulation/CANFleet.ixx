@@ -0,0 +1,280 @@
+// CANFleet.ixx - Fleet-Scale Simulation on a Shared Worker Pool
+// Runs many virtual-time CAN buses as tasks on a fixed-size work-stealing
+// thread pool instead of dedicating threads to every bus and node.
+
+module;
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+
+export module CANFleet;
+
+import CANBusSimulation;
+
+using namespace std;
+using namespace std::chrono;
+
+export namespace CANSim {
+
+    // ========================================
+    // Work-Stealing Thread Pool
+    // ========================================
+
+    // Fixed set of workers, each with its own task deque. A worker pops its
+    // newest task (cache-warm), and idle workers steal the oldest task from
+    // the others. Tasks passed to submit() must not throw; parallelFor()
+    // forwards the first exception to its caller.
+    class WorkStealingPool {
+    private:
+        struct Worker {
+            mutex queueMutex;
+            deque<function<void()>> tasks;
+        };
+
+        vector<unique_ptr<Worker>> workers;
+        vector<thread> threads;
+        atomic<size_t> queuedTasks{0};
+        atomic<size_t> nextQueue{0};       // round-robin target for external submits
+        atomic<bool> running{true};
+        mutex sleepMutex;
+        condition_variable sleepCondition;
+
+        // Index of the calling thread in this pool, or SIZE_MAX
+        size_t currentWorker() const {
+            return currentPool() == this ? currentIndex() : SIZE_MAX;
+        }
+
+        static const WorkStealingPool*& currentPool() {
+            thread_local const WorkStealingPool* pool = nullptr;
+            return pool;
+        }
+
+        static size_t& currentIndex() {
+            thread_local size_t index = SIZE_MAX;
+            return index;
+        }
+
+        bool popLocal(size_t index, function<void()>& task) {
+            Worker& worker = *workers[index];
+            lock_guard<mutex> lock(worker.queueMutex);
+            if (worker.tasks.empty()) return false;
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            return true;
+        }
+
+        bool steal(size_t thief, function<void()>& task) {
+            size_t count = workers.size();
+            for (size_t i = 1; i <= count; ++i) {
+                Worker& victim = *workers[(thief + i) % count];
+                lock_guard<mutex> lock(victim.queueMutex);
+                if (!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Runs one queued task on the calling thread, if there is any
+        bool tryRunOne() {
+            if (queuedTasks.load(memory_order_acquire) == 0) return false;
+
+            size_t index = currentWorker();
+            function<void()> task;
+            bool found = (index != SIZE_MAX && popLocal(index, task)) ||
+                         steal(index != SIZE_MAX ? index : nextQueue.load(memory_order_relaxed), task);
+            if (!found) return false;
+
+            queuedTasks.fetch_sub(1, memory_order_relaxed);
+            task();
+            return true;
+        }
+
+        void workerLoop(size_t index) {
+            currentPool() = this;
+            currentIndex() = index;
+
+            while (true) {
+                if (tryRunOne()) continue;
+
+                unique_lock<mutex> lock(sleepMutex);
+                if (!running.load() && queuedTasks.load() == 0) break;
+                sleepCondition.wait(lock, [this] {
+                    return queuedTasks.load() > 0 || !running.load();
+                });
+            }
+        }
+
+    public:
+        explicit WorkStealingPool(size_t threadCount = thread::hardware_concurrency()) {
+            threadCount = max<size_t>(threadCount, 1);
+            for (size_t i = 0; i < threadCount; ++i) {
+                workers.push_back(make_unique<Worker>());
+            }
+            for (size_t i = 0; i < threadCount; ++i) {
+                threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+            }
+        }
+
+        // Finishes all queued tasks, then stops the workers
+        ~WorkStealingPool() {
+            {
+                lock_guard<mutex> lock(sleepMutex);
+                running.store(false);
+            }
+            sleepCondition.notify_all();
+            for (auto& worker : threads) {
+                worker.join();
+            }
+        }
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        void submit(function<void()> task) {
+            size_t index = currentWorker();
+            if (index == SIZE_MAX) {
+                index = nextQueue.fetch_add(1, memory_order_relaxed) % workers.size();
+            }
+            {
+                lock_guard<mutex> lock(workers[index]->queueMutex);
+                workers[index]->tasks.push_back(std::move(task));
+            }
+            queuedTasks.fetch_add(1, memory_order_release);
+            {
+                lock_guard<mutex> lock(sleepMutex);
+            }
+            sleepCondition.notify_one();
+        }
+
+        // Runs body(0..count-1) as pool tasks and waits for all of them. The
+        // calling thread executes tasks while it waits, so this may be
+        // called from inside a pool task.
+        void parallelFor(size_t count, const function<void(size_t)>& body) {
+            atomic<size_t> remaining{count};
+            exception_ptr firstError;
+            mutex errorMutex;
+
+            for (size_t i = 0; i < count; ++i) {
+                submit([&, i] {
+                    try {
+                        body(i);
+                    } catch (...) {
+                        lock_guard<mutex> lock(errorMutex);
+                        if (!firstError) firstError = current_exception();
+                    }
+                    remaining.fetch_sub(1, memory_order_acq_rel);
+                });
+            }
+
+            while (remaining.load(memory_order_acquire) > 0) {
+                if (!tryRunOne()) {
+                    this_thread::yield();
+                }
+            }
+
+            if (firstError) {
+                rethrow_exception(firstError);
+            }
+        }
+
+        size_t size() const { return workers.size(); }
+    };
+
+    // ========================================
+    // Fleet Simulation (Parallel Virtual Buses)
+    // ========================================
+
+    // A set of virtual-time buses that advance together in fixed slices of
+    // simulated time. Within a slice every bus runs its own event loop as an
+    // independent pool task, so throughput scales with cores; the slice
+    // boundary bounds how far buses drift apart, which keeps traffic between
+    // buses (gateways, shared nodes) within one slice of causality.
+    class FleetSimulation {
+    private:
+        WorkStealingPool pool;
+        vector<shared_ptr<CANBus>> buses;
+        steady_clock::time_point fleetNow{};    // simulated time all buses have reached
+        steady_clock::duration sliceLength = 10ms;
+        double wallClockSpeed = 0.0;            // 0 = as fast as possible
+
+    public:
+        explicit FleetSimulation(size_t threadCount = thread::hardware_concurrency())
+            : pool(threadCount) {}
+
+        // Creates a virtual-time bus that the fleet drives
+        shared_ptr<CANBus> createBus(size_t transmitQueueCapacity = CANBus::DEFAULT_TRANSMIT_QUEUE_CAPACITY) {
+            auto bus = make_shared<CANBus>(TimeMode::VIRTUAL_TIME, transmitQueueCapacity);
+            bus->setRandomStream(buses.size());     // uncorrelated faults and load per bus
+            addBus(bus);
+            return bus;
+        }
+
+        void addBus(shared_ptr<CANBus> bus) {
+            if (bus->getTimeMode() != TimeMode::VIRTUAL_TIME) {
+                throw invalid_argument("FleetSimulation requires TimeMode::VIRTUAL_TIME buses");
+            }
+            buses.push_back(std::move(bus));
+        }
+
+        void setSliceLength(steady_clock::duration length) {
+            if (length <= steady_clock::duration::zero()) {
+                throw invalid_argument("Slice length must be positive");
+            }
+            sliceLength = length;
+        }
+
+        // Paces slices against the wall clock: 1.0 = real time, 2.0 = twice
+        // as fast, 0 = unpaced
+        void setWallClockPacing(double speed) { wallClockSpeed = max(speed, 0.0); }
+
+        void runUntil(steady_clock::time_point until) {
+            auto wallStart = steady_clock::now();
+            auto simStart = fleetNow;
+
+            while (fleetNow < until) {
+                auto sliceEnd = min(fleetNow + sliceLength, until);
+                pool.parallelFor(buses.size(), [&](size_t i) {
+                    buses[i]->runUntil(sliceEnd);
+                });
+                fleetNow = sliceEnd;
+
+                if (wallClockSpeed > 0.0) {
+                    auto simulated = duration<double>(fleetNow - simStart) / wallClockSpeed;
+                    this_thread::sleep_until(wallStart + duration_cast<steady_clock::duration>(simulated));
+                }
+            }
+        }
+
+        void runFor(steady_clock::duration length) {
+            runUntil(fleetNow + length);
+        }
+
+        steady_clock::time_point now() const { return fleetNow; }
+        size_t getBusCount() const { return buses.size(); }
+        const vector<shared_ptr<CANBus>>& getBuses() const { return buses; }
+        WorkStealingPool& getPool() { return pool; }
+
+        uint64_t getTotalMessages() const {
+            uint64_t total = 0;
+            for (const auto& bus : buses) {
+                total += bus->getTotalMessages();
+            }
+            return total;
+        }
+    };
+
+} // namespace CANSim
@@ -0,0 +1,525 @@
+// CANGateway.ixx - Multi-Bus Gateway
+// Joins several CAN buses (e.g. powertrain, chassis and body) through a
+// central gateway that forwards frames by compiled ID/mask routes, with
+// optional ID translation and per-route rate limiting.
+
+module;
+
+#include <vector>
+#include <deque>
+#include <array>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+
+export module CANGateway;
+
+import CANBusSimulation;
+
+using namespace std;
+using namespace std::chrono;
+
+export namespace CANSim {
+
+    // ========================================
+    // Gateway Routes
+    // ========================================
+
+    // One forwarding rule: frames on port 'source' that pass 'match' are sent
+    // on port 'destination' with the ID rewritten as
+    // (id & ~rewriteMask) | rewriteValue, so a zero mask keeps the ID and a
+    // full mask replaces it. A positive maxFramesPerSecond rate-limits the
+    // route with a token bucket holding up to 'burst' frames.
+    struct GatewayRoute {
+        size_t source = 0;
+        size_t destination = 0;
+        AcceptanceFilter match;
+        uint32_t rewriteMask = 0;
+        uint32_t rewriteValue = 0;
+        double maxFramesPerSecond = 0.0;    // 0 = unlimited
+        uint32_t burst = 1;
+
+        static GatewayRoute forward(size_t source, size_t destination, AcceptanceFilter match) {
+            GatewayRoute route;
+            route.source = source;
+            route.destination = destination;
+            route.match = match;
+            return route;
+        }
+
+        GatewayRoute& translateTo(uint32_t canId) {
+            rewriteMask = match.format == CANFormat::STANDARD ? CAN_MAX_STANDARD_ID : CAN_MAX_EXTENDED_ID;
+            rewriteValue = canId;
+            return *this;
+        }
+
+        GatewayRoute& limitRate(double framesPerSecond, uint32_t burstFrames = 1) {
+            maxFramesPerSecond = framesPerSecond;
+            burst = burstFrames;
+            return *this;
+        }
+
+        uint32_t translate(uint32_t canId) const {
+            return (canId & ~rewriteMask) | (rewriteValue & rewriteMask);
+        }
+    };
+
+    // Per-route counters. Latency runs from the end of the frame on the
+    // source bus to the end of the forwarded frame on the destination bus.
+    struct GatewayRouteStats {
+        uint64_t received = 0;          // frames that matched the route
+        uint64_t forwarded = 0;         // completed on the destination bus
+        uint64_t rateLimited = 0;       // dropped by the token bucket
+        uint64_t overflowed = 0;        // dropped: handoff lane or transmit queue full
+        nanoseconds minLatency{0};
+        nanoseconds averageLatency{0};
+        nanoseconds maxLatency{0};
+    };
+
+    // ========================================
+    // Compiled Route Table
+    // ========================================
+
+    // ID -> routes lookup for one source bus, laid out like the bus
+    // SubscriberTable: standard IDs index a 2048-entry table, extended IDs
+    // are resolved on first use and cached, and identical route sets share
+    // one list. Compiled once when the gateway starts.
+    class RouteTable {
+    private:
+        static constexpr size_t STANDARD_ID_COUNT = CAN_MAX_STANDARD_ID + 1;
+        static constexpr size_t EXTENDED_CACHE_LIMIT = 4096;
+
+        using RouteList = vector<uint32_t>;
+
+        vector<RouteList> lists{RouteList{}};               // list 0 = no routes
+        array<uint32_t, STANDARD_ID_COUNT> standardRoutes{};
+        unordered_map<uint32_t, uint32_t> extendedRoutes;
+        vector<pair<uint32_t, AcceptanceFilter>> rules;     // route index, match
+
+        uint32_t findOrAddList(RouteList&& list) {
+            for (uint32_t i = 0; i < lists.size(); ++i) {
+                if (lists[i] == list) return i;
+            }
+            lists.push_back(std::move(list));
+            return static_cast<uint32_t>(lists.size() - 1);
+        }
+
+        uint32_t resolve(uint32_t canId, CANFormat format) {
+            RouteList list;
+            for (const auto& [route, match] : rules) {
+                if (match.matches(canId, format)) list.push_back(route);
+            }
+            return findOrAddList(std::move(list));
+        }
+
+    public:
+        void compile(vector<pair<uint32_t, AcceptanceFilter>> routeRules) {
+            rules = std::move(routeRules);
+            lists.assign(1, RouteList{});
+            extendedRoutes.clear();
+            for (uint32_t canId = 0; canId < STANDARD_ID_COUNT; ++canId) {
+                standardRoutes[canId] = resolve(canId, CANFormat::STANDARD);
+            }
+        }
+
+        const RouteList& routes(uint32_t canId, CANFormat format) {
+            if (format == CANFormat::STANDARD) {
+                return lists[standardRoutes[canId & CAN_MAX_STANDARD_ID]];
+            }
+            auto it = extendedRoutes.find(canId);
+            if (it == extendedRoutes.end()) {
+                if (extendedRoutes.size() >= EXTENDED_CACHE_LIMIT) extendedRoutes.clear();
+                it = extendedRoutes.emplace(canId, resolve(canId, CANFormat::EXTENDED)).first;
+            }
+            return lists[it->second];
+        }
+
+        size_t getListCount() const { return lists.size(); }
+    };
+
+    // ========================================
+    // CAN Gateway
+    // ========================================
+
+    // A node on every attached bus. Frames are matched on the source bus's
+    // own thread (its bus thread, or the pool worker running it in a
+    // FleetSimulation) and handed to the destination through a lock-free
+    // ring per (source, destination) pair. A push into an idle destination
+    // schedules a one-shot drain on that bus, which transmits on its own
+    // thread, so no bus ever touches another bus's state.
+    //
+    //     CANGateway gateway(0x7F0);
+    //     size_t powertrain = gateway.addBus(powertrainBus, "Powertrain");
+    //     size_t body = gateway.addBus(bodyBus, "Body");
+    //     gateway.addRoute(GatewayRoute::forward(powertrain, body, AcceptanceFilter::exact(0x100))
+    //                          .translateTo(0x500).limitRate(10.0));
+    //     gateway.start();
+    //
+    // The gateway node ID must not be used by another node on any of the
+    // buses; removeNode() detaches every node with that ID.
+    class CANGateway {
+    private:
+        // Arrival time on the source bus travels in the message timestamp
+        struct ForwardedFrame {
+            CANMessage message;
+            uint32_t route = 0;
+        };
+
+        struct Lane {
+            size_t source;
+            size_t destination;
+            MPSCRing<ForwardedFrame> ring;     // source bus producer, destination bus consumer
+            deque<ForwardedFrame> early;       // popped before the destination reached their arrival time
+
+            // Set while a drain is scheduled or running; the producer only
+            // schedules one when it finds this clear
+            atomic<bool> drainPending{false};
+            atomic<TimerId> drainTimer{0};
+
+            Lane(size_t sourcePort, size_t destinationPort, size_t capacity)
+                : source(sourcePort), destination(destinationPort), ring(capacity) {}
+        };
+
+        struct RouteState {
+            GatewayRoute route;
+            size_t lane = 0;
+
+            // Token bucket in nanoseconds of credit, one frame costing
+            // 1 s / maxFramesPerSecond (source bus thread only)
+            int64_t frameCostNs = 0;
+            int64_t creditNs = 0;
+            steady_clock::time_point lastRefill{};
+            bool bucketStarted = false;
+
+            atomic<uint64_t> received{0};
+            atomic<uint64_t> forwarded{0};
+            atomic<uint64_t> rateLimited{0};
+            atomic<uint64_t> overflowed{0};
+
+            // Latency (destination bus thread writes, anyone reads)
+            atomic<int64_t> latencySumNs{0};
+            atomic<int64_t> minLatencyNs{INT64_MAX};
+            atomic<int64_t> maxLatencyNs{0};
+
+            bool takeToken(steady_clock::time_point now) {
+                if (frameCostNs == 0) return true;
+                int64_t capacityNs = frameCostNs * route.burst;
+                if (!bucketStarted) {
+                    creditNs = capacityNs;
+                    lastRefill = now;
+                    bucketStarted = true;
+                }
+                creditNs = min(capacityNs, creditNs + duration_cast<nanoseconds>(now - lastRefill).count());
+                lastRefill = now;
+                if (creditNs < frameCostNs) return false;
+                creditNs -= frameCostNs;
+                return true;
+            }
+        };
+
+        struct InFlightFrame {
+            uint32_t route;
+            steady_clock::time_point arrival;
+        };
+
+        struct Port {
+            string name;
+            shared_ptr<CANBus> bus;
+            shared_ptr<CANNode> node;
+            RouteTable table;                           // source bus thread only
+            vector<size_t> incomingLanes;               // drained on this bus
+
+            // Forwarded frames awaiting transmit confirmation, FIFO per ID like
+            // the bus arbitration queue (destination bus thread only)
+            unordered_map<uint64_t, deque<InFlightFrame>> inFlight;
+        };
+
+        uint32_t nodeId;
+        string gatewayName;
+        vector<unique_ptr<Port>> ports;
+        vector<unique_ptr<RouteState>> routes;
+        vector<unique_ptr<Lane>> lanes;
+        size_t laneCapacity = 256;
+        bool running = false;
+
+        static uint64_t frameKey(const CANMessage& message) {
+            return (static_cast<uint64_t>(message.format == CANFormat::EXTENDED) << 32) | message.id;
+        }
+
+        // Source bus thread: match, rate-limit, translate and hand off
+        void ingress(Port& port, const CANMessage& message) {
+            const auto& matched = port.table.routes(message.id, message.format);
+            if (matched.empty()) return;
+
+            auto arrival = port.bus->now();
+            for (uint32_t index : matched) {
+                RouteState& state = *routes[index];
+                state.received.fetch_add(1, memory_order_relaxed);
+                if (!state.takeToken(arrival)) {
+                    state.rateLimited.fetch_add(1, memory_order_relaxed);
+                    continue;
+                }
+
+                ForwardedFrame frame{message, index};
+                frame.message.id = state.route.translate(message.id);
+                frame.message.timestamp = arrival;
+                Lane& lane = *lanes[state.lane];
+                if (!lane.ring.tryPush(frame)) {
+                    state.overflowed.fetch_add(1, memory_order_relaxed);
+                    continue;
+                }
+                if (!lane.drainPending.exchange(true, memory_order_acq_rel)) {
+                    scheduleDrain(lane, arrival);
+                }
+            }
+        }
+
+        void scheduleDrain(Lane& lane, steady_clock::time_point when) {
+            lane.drainTimer.store(ports[lane.destination]->bus->scheduleAt(when, [this, &lane] {
+                drain(lane);
+            }), memory_order_release);
+        }
+
+        // Destination bus thread: moves handed-off frames into the transmit
+        // queue. In a FleetSimulation the source bus may run ahead within a
+        // slice; its frames wait here until the destination reaches their
+        // arrival time, so forwarding never goes back in time. A lane's
+        // arrivals only move forward, so one pending drain per lane is enough.
+        void drain(Lane& lane) {
+            Port& port = *ports[lane.destination];
+            auto now = port.bus->now();
+            while (true) {
+                while (auto frame = lane.ring.tryPop()) {
+                    lane.early.push_back(std::move(*frame));
+                }
+                while (!lane.early.empty() && lane.early.front().message.timestamp <= now) {
+                    transmit(port, lane.early.front());
+                    lane.early.pop_front();
+                }
+                if (!lane.early.empty()) {
+                    scheduleDrain(lane, lane.early.front().message.timestamp);
+                    return;
+                }
+
+                // A push that saw the flag still set did not schedule; take it now
+                lane.drainPending.exchange(false, memory_order_acq_rel);
+                if (lane.ring.empty() || lane.drainPending.exchange(true, memory_order_acq_rel)) return;
+            }
+        }
+
+        void transmit(Port& port, ForwardedFrame& frame) {
+            frame.message.nodeId = nodeId;
+            if (!port.bus->transmitMessage(frame.message)) {
+                routes[frame.route]->overflowed.fetch_add(1, memory_order_relaxed);
+                return;
+            }
+            port.inFlight[frameKey(frame.message)].push_back({frame.route, frame.message.timestamp});
+        }
+
+        // Destination bus thread: a forwarded frame completed on the wire.
+        // Entries older than it belong to frames the bus dropped (OVERWRITE).
+        void confirm(Port& port, const CANMessage& message) {
+            auto it = port.inFlight.find(frameKey(message));
+            if (it == port.inFlight.end()) return;
+
+            auto& pending = it->second;
+            while (!pending.empty()) {
+                InFlightFrame entry = pending.front();
+                pending.pop_front();
+                if (entry.arrival == message.timestamp) {
+                    recordLatency(*routes[entry.route], port.bus->now() - entry.arrival);
+                    break;
+                }
+            }
+        }
+
+        static void recordLatency(RouteState& state, steady_clock::duration latency) {
+            int64_t ns = duration_cast<nanoseconds>(latency).count();
+            state.forwarded.fetch_add(1, memory_order_relaxed);
+            state.latencySumNs.fetch_add(ns, memory_order_relaxed);
+            if (ns < state.minLatencyNs.load(memory_order_relaxed)) state.minLatencyNs.store(ns, memory_order_relaxed);
+            if (ns > state.maxLatencyNs.load(memory_order_relaxed)) state.maxLatencyNs.store(ns, memory_order_relaxed);
+        }
+
+        size_t laneFor(size_t source, size_t destination) {
+            for (size_t i : ports[destination]->incomingLanes) {
+                if (lanes[i]->source == source) return i;
+            }
+            lanes.push_back(make_unique<Lane>(source, destination, laneCapacity));
+            ports[destination]->incomingLanes.push_back(lanes.size() - 1);
+            return lanes.size() - 1;
+        }
+
+        void requireStopped(const char* operation) const {
+            if (running) {
+                throw logic_error(string(operation) + " requires a stopped gateway");
+            }
+        }
+
+    public:
+        explicit CANGateway(uint32_t gatewayNodeId, const string& name = "Gateway")
+            : nodeId(gatewayNodeId), gatewayName(name) {}
+
+        ~CANGateway() {
+            stop();
+        }
+
+        CANGateway(const CANGateway&) = delete;
+        CANGateway& operator=(const CANGateway&) = delete;
+
+        // Attaches a bus; returns its port index for routes
+        size_t addBus(shared_ptr<CANBus> bus, const string& name) {
+            requireStopped("addBus");
+            if (!bus) {
+                throw invalid_argument("Gateway bus must not be null");
+            }
+            auto port = make_unique<Port>();
+            port->name = name;
+            port->bus = std::move(bus);
+            ports.push_back(std::move(port));
+            return ports.size() - 1;
+        }
+
+        // Returns the route index for getRouteStats()
+        size_t addRoute(const GatewayRoute& route) {
+            requireStopped("addRoute");
+            if (route.source >= ports.size() || route.destination >= ports.size()) {
+                throw invalid_argument("Gateway route refers to an unknown bus");
+            }
+            if (route.source == route.destination) {
+                throw invalid_argument("Gateway route must connect two different buses");
+            }
+            uint32_t maxId = route.match.format == CANFormat::STANDARD ? CAN_MAX_STANDARD_ID : CAN_MAX_EXTENDED_ID;
+            if ((route.rewriteMask | route.rewriteValue) > maxId) {
+                throw invalid_argument("Gateway ID translation exceeds the frame format's ID range");
+            }
+            if (route.maxFramesPerSecond > 0.0 && route.burst == 0) {
+                throw invalid_argument("Rate-limited gateway route needs a burst of at least one frame");
+            }
+
+            auto state = make_unique<RouteState>();
+            state->route = route;
+            routes.push_back(std::move(state));
+            return routes.size() - 1;
+        }
+
+        // Frames each (source, destination) handoff ring holds until the destination drains it
+        void setLaneCapacity(size_t capacity) {
+            requireStopped("setLaneCapacity");
+            laneCapacity = max<size_t>(capacity, 2);
+        }
+
+        // Compiles the route tables and joins every bus
+        void start() {
+            if (running) return;
+
+            lanes.clear();
+            for (auto& port : ports) {
+                port->incomingLanes.clear();
+                port->inFlight.clear();
+            }
+
+            vector<vector<pair<uint32_t, AcceptanceFilter>>> rules(ports.size());
+            for (uint32_t index = 0; index < routes.size(); ++index) {
+                RouteState& state = *routes[index];
+                state.lane = laneFor(state.route.source, state.route.destination);
+                state.frameCostNs = state.route.maxFramesPerSecond > 0.0
+                    ? max<int64_t>(static_cast<int64_t>(1e9 / state.route.maxFramesPerSecond), 1) : 0;
+                state.bucketStarted = false;
+                rules[state.route.source].emplace_back(index, state.route.match);
+            }
+
+            for (size_t i = 0; i < ports.size(); ++i) {
+                Port* port = ports[i].get();
+                port->table.compile(rules[i]);
+
+                // The node only hears frames some route wants; a bus that is
+                // only a destination hears none
+                port->node = make_shared<CANNode>(nodeId, gatewayName + " (" + port->name + ")");
+                vector<AcceptanceFilter> filters;
+                for (const auto& [route, match] : rules[i]) filters.push_back(match);
+                if (filters.empty()) filters.push_back(AcceptanceFilter::none());
+                port->node->setAcceptanceFilters(std::move(filters));
+                port->node->setMessageHandler([this, port](const CANMessage& message) {
+                    ingress(*port, message);
+                });
+                port->node->setTransmitConfirmHandler([this, port](const CANMessage& message) {
+                    confirm(*port, message);
+                });
+                port->bus->addNode(port->node);
+            }
+
+            running = true;
+            logInfo(LogTag::GATEWAY, "{} started: {} routes across {} buses", gatewayName, routes.size(), ports.size());
+        }
+
+        // Leaves every bus; frames still in the handoff rings are dropped
+        void stop() {
+            if (!running) return;
+            // Once no source delivers, only a running drain can schedule
+            // another; cancelling waits for it, then takes its successor
+            for (auto& port : ports) {
+                port->bus->removeNode(nodeId);
+            }
+            for (auto& lane : lanes) {
+                while (TimerId timer = lane->drainTimer.exchange(0, memory_order_acq_rel)) {
+                    ports[lane->destination]->bus->cancelTimer(timer);
+                }
+            }
+            for (auto& port : ports) {
+                port->node.reset();
+            }
+            running = false;
+            logInfo(LogTag::GATEWAY, "{} stopped", gatewayName);
+        }
+
+        bool isRunning() const { return running; }
+        size_t getBusCount() const { return ports.size(); }
+        size_t getRouteCount() const { return routes.size(); }
+        const GatewayRoute& getRoute(size_t route) const { return routes.at(route)->route; }
+
+        GatewayRouteStats getRouteStats(size_t route) const {
+            const RouteState& state = *routes.at(route);
+            GatewayRouteStats stats;
+            stats.received = state.received.load(memory_order_relaxed);
+            stats.forwarded = state.forwarded.load(memory_order_relaxed);
+            stats.rateLimited = state.rateLimited.load(memory_order_relaxed);
+            stats.overflowed = state.overflowed.load(memory_order_relaxed);
+            if (stats.forwarded > 0) {
+                stats.minLatency = nanoseconds(state.minLatencyNs.load(memory_order_relaxed));
+                stats.maxLatency = nanoseconds(state.maxLatencyNs.load(memory_order_relaxed));
+                stats.averageLatency = nanoseconds(state.latencySumNs.load(memory_order_relaxed)
+                                                   / static_cast<int64_t>(stats.forwarded));
+            }
+            return stats;
+        }
+
+        void printStatistics() const {
+            Logger::instance().flush(); // keep queued log lines ahead of the report
+            cout << "\n=== " << gatewayName << " Routes ===" << endl;
+            cout << left << setw(28) << "Route" << right << setw(9) << "Received" << setw(10) << "Forwarded"
+                 << setw(9) << "Limited" << setw(9) << "Dropped" << setw(28) << "Latency min/avg/max (us)" << endl;
+            for (size_t i = 0; i < routes.size(); ++i) {
+                const GatewayRoute& route = routes[i]->route;
+                GatewayRouteStats stats = getRouteStats(i);
+
+                string name = ports[route.source]->name + " -> " + ports[route.destination]->name;
+                cout << left << setw(28) << name << right << setw(9) << stats.received
+                     << setw(10) << stats.forwarded << setw(9) << stats.rateLimited << setw(9) << stats.overflowed
+                     << fixed << setprecision(1)
+                     << setw(10) << stats.minLatency.count() / 1000.0
+                     << setw(9) << stats.averageLatency.count() / 1000.0
+                     << setw(9) << stats.maxLatency.count() / 1000.0 << endl;
+            }
+            cout << defaultfloat << "=====================" << endl;
+        }
+    };
+
+} // namespace CANSim
@@ -0,0 +1,349 @@
+// CANLoadGenerator.ixx - Synthetic Bus Load Generator
+// Adds N virtual ECUs with M periodic or sporadic messages each to a bus,
+// with configurable ID distribution, DLC mix, period jitter and bursts.
+// Every message is released by one scheduler driven by a single bus timer,
+// so the generator needs no threads of its own.
+
+module;
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <span>
+#include <cstdint>
+
+export module CANLoadGenerator;
+
+import CANBusSimulation;
+
+using namespace std;
+using namespace std::chrono;
+
+export namespace CANSim {
+
+    // ========================================
+    // Load Profile
+    // ========================================
+
+    enum class IdDistribution {
+        SEQUENTIAL,         // consecutive IDs from idLow, ECU by ECU
+        UNIFORM,            // distinct IDs drawn at random from [idLow, idHigh]
+        RATE_MONOTONIC      // random IDs, the shortest periods get the lowest (highest priority) IDs
+    };
+
+    // What the generator puts on the bus. The same profile and seed always
+    // produce the same message set and release times on buses with the
+    // same random stream (CANBus::setRandomStream).
+    struct LoadProfile {
+        uint32_t ecuCount = 10;
+        uint32_t messagesPerEcu = 5;
+        uint32_t firstNodeId = 100;             // ECU e is node firstNodeId + e
+
+        IdDistribution idDistribution = IdDistribution::RATE_MONOTONIC;
+        uint32_t idLow = 0x080;
+        uint32_t idHigh = CAN_MAX_STANDARD_ID;
+        CANFormat format = CANFormat::STANDARD;
+
+        // Relative weight of each DLC 0..8; every message keeps its drawn DLC
+        array<double, 9> dlcWeights = {0, 0, 0, 0, 0, 0, 0, 0, 1};
+
+        // Each message draws its period from this list. Sporadic messages use
+        // it as the mean of an exponential gap instead of a fixed period.
+        vector<milliseconds> periods = {10ms, 20ms, 50ms, 100ms, 500ms};
+        double sporadicShare = 0.0;             // share of messages that are sporadic
+        double periodJitter = 0.0;              // each release moves by up to +-jitter * period
+        double rateScale = 1.0;                 // > 1 sends every message more often
+
+        // An activation sends a burst of burstLength frames with this probability
+        double burstProbability = 0.0;
+        uint32_t burstLength = 1;
+        microseconds burstSpacing{0};           // 0 = queue the whole burst at once
+
+        uint64_t seed = 1;                      // mixed with SimulationSeed when one is set
+    };
+
+    struct GeneratedMessage {
+        uint32_t id = 0;
+        uint32_t nodeId = 0;
+        uint8_t dlc = 0;
+        nanoseconds period{0};                  // mean gap for sporadic messages
+        bool sporadic = false;
+    };
+
+    struct LoadGeneratorStats {
+        uint64_t activations = 0;               // periodic or sporadic releases
+        uint64_t framesSent = 0;
+        uint64_t framesRejected = 0;            // transmit queue full
+    };
+
+    // ========================================
+    // Load Generator
+    // ========================================
+
+    class LoadGenerator {
+    private:
+        // Release schedule entry; the heap keeps the earliest release on top
+        struct Release {
+            steady_clock::time_point time;
+            uint32_t message;
+
+            bool operator>(const Release& other) const {
+                return time != other.time ? time > other.time : message > other.message;
+            }
+        };
+
+        struct MessageState {
+            steady_clock::time_point nominal;   // jitter-free release, keeps the phase
+            uint32_t burstRemaining = 0;
+            uint32_t counter = 0;               // payload content
+        };
+
+        shared_ptr<CANBus> canBus;
+        LoadProfile profile;
+        vector<GeneratedMessage> messages;
+        vector<shared_ptr<CANNode>> ecus;
+
+        // Touched only by the thread that runs bus timers once started
+        vector<MessageState> states;
+        vector<Release> schedule;
+        mt19937_64 random;
+
+        atomic<bool> running{false};
+        atomic<TimerId> timer{0};
+        atomic<uint64_t> activations{0};
+        atomic<uint64_t> framesSent{0};
+        atomic<uint64_t> framesRejected{0};
+
+        vector<uint32_t> drawIds(size_t count) {
+            uint64_t range = uint64_t(profile.idHigh) - profile.idLow + 1;
+            if (profile.idHigh < profile.idLow || count > range) {
+                throw invalid_argument("ID range too small for ecuCount * messagesPerEcu messages");
+            }
+            vector<uint32_t> ids;
+            ids.reserve(count);
+            if (profile.idDistribution == IdDistribution::SEQUENTIAL) {
+                for (size_t i = 0; i < count; ++i) ids.push_back(profile.idLow + static_cast<uint32_t>(i));
+                return ids;
+            }
+            // Floyd's sampling: 'count' distinct values without materializing the range
+            vector<uint32_t> chosen;
+            for (uint64_t j = range - count; j < range; ++j) {
+                uint32_t candidate = static_cast<uint32_t>(uniform_int_distribution<uint64_t>(0, j)(random));
+                if (find(chosen.begin(), chosen.end(), candidate) != chosen.end()) {
+                    candidate = static_cast<uint32_t>(j);
+                }
+                chosen.push_back(candidate);
+            }
+            for (uint32_t offset : chosen) ids.push_back(profile.idLow + offset);
+            shuffle(ids.begin(), ids.end(), random);
+            return ids;
+        }
+
+        void buildMessages() {
+            size_t count = size_t(profile.ecuCount) * profile.messagesPerEcu;
+            if (profile.periods.empty()) throw invalid_argument("Load profile needs at least one period");
+            if (profile.rateScale <= 0.0) throw invalid_argument("Rate scale must be positive");
+            if (profile.periodJitter < 0.0 || profile.periodJitter >= 1.0) {
+                throw invalid_argument("Period jitter must be in [0, 1)");
+            }
+            uint32_t maxId = profile.format == CANFormat::STANDARD ? CAN_MAX_STANDARD_ID : CAN_MAX_EXTENDED_ID;
+            if (profile.idHigh > maxId) throw invalid_argument("idHigh exceeds the identifier range");
+
+            discrete_distribution<int> dlcs(profile.dlcWeights.begin(), profile.dlcWeights.end());
+            uniform_int_distribution<size_t> periodChoice(0, profile.periods.size() - 1);
+            bernoulli_distribution sporadic(profile.sporadicShare);
+
+            messages.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                auto& message = messages[i];
+                message.nodeId = profile.firstNodeId + static_cast<uint32_t>(i / profile.messagesPerEcu);
+                message.dlc = static_cast<uint8_t>(dlcs(random));
+                message.period = duration_cast<nanoseconds>(profile.periods[periodChoice(random)] / profile.rateScale);
+                message.period = max(message.period, nanoseconds(1000));
+                message.sporadic = sporadic(random);
+            }
+
+            vector<uint32_t> ids = drawIds(count);
+            if (profile.idDistribution == IdDistribution::RATE_MONOTONIC) {
+                sort(ids.begin(), ids.end());
+                vector<size_t> order(count);
+                for (size_t i = 0; i < count; ++i) order[i] = i;
+                shuffle(order.begin(), order.end(), random);   // equal periods share out IDs at random
+                stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+                    return messages[a].period < messages[b].period;
+                });
+                for (size_t rank = 0; rank < count; ++rank) messages[order[rank]].id = ids[rank];
+            } else {
+                for (size_t i = 0; i < count; ++i) messages[i].id = ids[i];
+            }
+        }
+
+        nanoseconds nextGap(const GeneratedMessage& message) {
+            if (message.sporadic) {
+                exponential_distribution<double> gap(1.0 / message.period.count());
+                return nanoseconds(max<int64_t>(1, static_cast<int64_t>(gap(random))));
+            }
+            return message.period;
+        }
+
+        steady_clock::time_point jittered(steady_clock::time_point nominal, const GeneratedMessage& message) {
+            if (message.sporadic || profile.periodJitter == 0.0) return nominal;
+            uniform_real_distribution<double> shift(-profile.periodJitter, profile.periodJitter);
+            return nominal + nanoseconds(static_cast<int64_t>(shift(random) * message.period.count()));
+        }
+
+        void push(Release release) {
+            schedule.push_back(release);
+            push_heap(schedule.begin(), schedule.end(), greater<Release>());
+        }
+
+        void send(uint32_t index) {
+            const auto& message = messages[index];
+            auto& state = states[index];
+            array<uint8_t, 8> payload{};
+            for (size_t i = 0; i < message.dlc; ++i) {
+                payload[i] = static_cast<uint8_t>((state.counter >> (8 * (i % 4))) + i);
+            }
+            ++state.counter;
+
+            CANMessage frame(message.id, span<const uint8_t>(payload.data(), message.dlc),
+                             profile.format, message.nodeId);
+            if (canBus->transmitMessage(frame)) {
+                framesSent.fetch_add(1, memory_order_relaxed);
+            } else {
+                framesRejected.fetch_add(1, memory_order_relaxed);
+            }
+        }
+
+        // One message is due: an activation (maybe starting a burst) or the
+        // next frame of a spaced burst
+        void release(uint32_t index, steady_clock::time_point now) {
+            const auto& message = messages[index];
+            auto& state = states[index];
+
+            if (state.burstRemaining == 0) {
+                activations.fetch_add(1, memory_order_relaxed);
+                bool burst = profile.burstLength > 1 && bernoulli_distribution(profile.burstProbability)(random);
+                state.burstRemaining = burst ? profile.burstLength : 1;
+            }
+            if (profile.burstSpacing == microseconds(0)) {
+                for (; state.burstRemaining > 0; --state.burstRemaining) send(index);
+            } else {
+                send(index);
+                if (--state.burstRemaining > 0) {
+                    push({now + profile.burstSpacing, index});
+                    return;
+                }
+            }
+
+            state.nominal += nextGap(message);
+            push({max(jittered(state.nominal, message), now), index});
+        }
+
+        // Timer action: releases everything due, then re-arms for the earliest
+        void releaseDue() {
+            if (!running.load()) return;
+            auto now = canBus->now();
+            while (!schedule.empty() && schedule.front().time <= now) {
+                pop_heap(schedule.begin(), schedule.end(), greater<Release>());
+                Release due = schedule.back();
+                schedule.pop_back();
+                release(due.message, now);
+            }
+            if (!schedule.empty()) {
+                timer.store(canBus->scheduleAt(schedule.front().time, [this] { releaseDue(); }));
+            }
+        }
+
+    public:
+        LoadGenerator(shared_ptr<CANBus> bus, const LoadProfile& loadProfile)
+            : canBus(bus), profile(loadProfile) {
+            if (!canBus) throw invalid_argument("Load generator needs a bus");
+            if (profile.ecuCount == 0 || profile.messagesPerEcu == 0) {
+                throw invalid_argument("Load profile needs at least one ECU and one message");
+            }
+            uint64_t seed = SimulationSeed::get() ? SimulationSeed::derive("LoadGenerator", profile.seed) : profile.seed;
+            uint64_t stream = canBus->getRandomStream();
+            seed_seq seeds{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+                           static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)};
+            random.seed(seeds);
+            buildMessages();
+
+            for (uint32_t e = 0; e < profile.ecuCount; ++e) {
+                auto ecu = make_shared<CANNode>(profile.firstNodeId + e, "ECU_" + to_string(e));
+                canBus->addNode(ecu);
+                ecus.push_back(ecu);
+            }
+        }
+
+        ~LoadGenerator() {
+            stop();
+            for (const auto& ecu : ecus) {
+                canBus->removeNode(ecu->getId());
+            }
+        }
+
+        LoadGenerator(const LoadGenerator&) = delete;
+        LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+        // Periodic messages start at a random phase within their first period
+        void start() {
+            if (running.exchange(true)) return;
+            auto now = canBus->now();
+            states.assign(messages.size(), MessageState{});
+            schedule.clear();
+            for (uint32_t i = 0; i < messages.size(); ++i) {
+                nanoseconds phase = messages[i].sporadic
+                    ? nextGap(messages[i])
+                    : nanoseconds(uniform_int_distribution<int64_t>(0, messages[i].period.count() - 1)(random));
+                states[i].nominal = now + phase;
+                push({max(jittered(states[i].nominal, messages[i]), now), i});
+            }
+            timer.store(canBus->scheduleAt(schedule.front().time, [this] { releaseDue(); }));
+        }
+
+        // Safe from any thread; once it returns no more frames are sent
+        void stop() {
+            if (!running.exchange(false)) return;
+            // A running releaseDue() may re-arm before it sees 'running'
+            for (;;) {
+                TimerId id = timer.load();
+                canBus->cancelTimer(id);
+                if (timer.load() == id) break;
+            }
+        }
+
+        bool isRunning() const { return running.load(); }
+
+        const vector<GeneratedMessage>& getMessages() const { return messages; }
+        const LoadProfile& getProfile() const { return profile; }
+
+        // Expected share of bus time the profile occupies (1.0 = saturated),
+        // from each message's frame time, rate and mean burst size
+        double offeredLoad() const {
+            double meanFrames = 1.0 + profile.burstProbability * (max(profile.burstLength, 1u) - 1.0);
+            array<uint8_t, 8> payload{};
+            double load = 0.0;
+            for (const auto& message : messages) {
+                CANMessage frame(message.id, span<const uint8_t>(payload.data(), message.dlc), profile.format);
+                load += meanFrames * canBus->frameDuration(frame).count() / message.period.count();
+            }
+            return load;
+        }
+
+        LoadGeneratorStats getStats() const {
+            LoadGeneratorStats stats;
+            stats.activations = activations.load(memory_order_relaxed);
+            stats.framesSent = framesSent.load(memory_order_relaxed);
+            stats.framesRejected = framesRejected.load(memory_order_relaxed);
+            return stats;
+        }
+    };
+}
@@ -0,0 +1,523 @@
+// CANLogImport.ixx - Field Log Import
+// Parses Linux candump (-l) and Vector ASC text logs into CANMessage
+// streams. Files are memory-mapped and cut into line-aligned chunks that are
+// parsed in parallel; frames are still delivered in file order.
+
+module;
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#include <span>
+#include <cstring>
+#include <cstdint>
+
+export module CANLogImport;
+
+import CANBusSimulation;
+import CANFleet;
+import CANTrace;
+
+using namespace std;
+using namespace std::chrono;
+
+export namespace CANSim {
+
+    // ========================================
+    // Log Import
+    // ========================================
+
+    enum class CANLogFormat {
+        AUTO = 0,           // Detect from the first line
+        CANDUMP = 1,        // candump -l: "(1436509052.249713) can0 123#DEADBEEF"
+        VECTOR_ASC = 2      // Vector ASCII: "0.010000 1  123  Rx  d 2 01 02"
+    };
+
+    struct LogImportStats {
+        uint64_t bytes = 0;
+        uint64_t lines = 0;
+        uint64_t frames = 0;
+        uint64_t skippedLines = 0;      // headers, comments, error/status events, malformed lines
+    };
+
+    // Streams the frames of a capture file:
+    //
+    //     CANLogImporter log("drive.log");
+    //     log.forEach([](const CANMessage& frame) { ... });
+    //     log.convertToTrace("drive.cantrace");    // then TraceReader::replay()
+    //
+    // Timestamps are the log's own times as steady_clock time points (epoch
+    // time for candump, time since measurement start for ASC). Frames of all
+    // interfaces/channels are merged unless a channel filter is set.
+    class CANLogImporter {
+    private:
+        struct Chunk {
+            size_t begin = 0;
+            size_t end = 0;
+            vector<CANMessage> frames;
+            LogImportStats stats;
+            int64_t elapsedNs = 0;      // sum of the chunk's relative ASC times
+        };
+
+        static constexpr uint32_t CAN_ERR_FLAG = 0x20000000;   // candump error frame marker
+
+        static constexpr array<int8_t, 256> HEX_DIGITS = [] {
+            array<int8_t, 256> digits{};
+            digits.fill(-1);
+            for (int i = 0; i < 10; ++i) digits['0' + i] = static_cast<int8_t>(i);
+            for (int i = 0; i < 6; ++i) {
+                digits['a' + i] = static_cast<int8_t>(10 + i);
+                digits['A' + i] = static_cast<int8_t>(10 + i);
+            }
+            return digits;
+        }();
+
+        MappedFile file;
+        string filePath;
+        CANLogFormat format;
+        WorkStealingPool pool;
+        size_t chunkSize = DEFAULT_CHUNK_SIZE;
+        string channelFilter;
+
+        // ASC header settings
+        size_t bodyOffset = 0;
+        uint64_t headerLines = 0;
+        bool decimalBase = false;
+        bool relativeTimestamps = false;
+
+        // ========================================
+        // Token Helpers
+        // ========================================
+
+        static const char* skipSpaces(const char* p, const char* end) {
+            while (p < end && (*p == ' ' || *p == '\t')) ++p;
+            return p;
+        }
+
+        static const char* tokenEnd(const char* p, const char* end) {
+            while (p < end && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+            return p;
+        }
+
+        static int hexDigit(char c) {
+            return HEX_DIGITS[static_cast<uint8_t>(c)];
+        }
+
+        // "1436509052.249713" -> nanoseconds (fraction digits beyond 9 are ignored)
+        static bool parseSeconds(const char*& p, const char* end, int64_t& timeNs) {
+            int64_t seconds = 0;
+            auto [next, error] = from_chars(p, end, seconds);
+            if (error != errc()) return false;
+
+            int64_t fraction = 0;
+            int digits = 0;
+            if (next < end && *next == '.') {
+                ++next;
+                while (next < end && static_cast<unsigned>(*next - '0') < 10) {
+                    if (digits < 9) {
+                        fraction = fraction * 10 + (*next - '0');
+                        ++digits;
+                    }
+                    ++next;
+                }
+            }
+            for (; digits < 9; ++digits) fraction *= 10;
+
+            timeNs = seconds * 1000000000LL + fraction;
+            p = next;
+            return true;
+        }
+
+        static bool validId(uint32_t id, bool extended) {
+            return id <= (extended ? CAN_MAX_EXTENDED_ID : CAN_MAX_STANDARD_ID);
+        }
+
+        static bool validFdLength(size_t length) {
+            return length <= CANFD_MAX_DATA_LENGTH && canFdDlcToLength(canFdLengthToDlc(length)) == length;
+        }
+
+        // ========================================
+        // candump -l
+        // ========================================
+
+        // (seconds.fraction) interface ID#data | ID#R[dlc] | ID##<flags>data
+        bool parseCandumpLine(const char* p, const char* end, CANMessage& message) const {
+            p = skipSpaces(p, end);
+            if (p == end || *p != '(') return false;
+            int64_t timeNs;
+            ++p;
+            if (!parseSeconds(p, end, timeNs) || p == end || *p != ')') return false;
+
+            p = skipSpaces(p + 1, end);
+            const char* interfaceEnd = tokenEnd(p, end);
+            if (!channelFilter.empty() && string_view(p, interfaceEnd - p) != channelFilter) return false;
+            p = skipSpaces(interfaceEnd, end);
+
+            uint32_t id;
+            auto [idEnd, error] = from_chars(p, end, id, 16);
+            if (error != errc() || idEnd == end || *idEnd != '#') return false;
+            bool extended = idEnd - p > 3;      // candump prints 3 digits for 11-bit IDs, 8 for 29-bit
+            if (extended && (id & CAN_ERR_FLAG)) return false;
+            if (!validId(id, extended)) return false;
+            p = idEnd + 1;
+
+            message.id = id;
+            message.format = extended ? CANFormat::EXTENDED : CANFormat::STANDARD;
+            message.timestamp = steady_clock::time_point(nanoseconds(timeNs));
+
+            if (p < end && *p == 'R') {
+                message.rtr = true;
+                message.frameType = CANFrameType::REMOTE_FRAME;
+                message.dlc = (p + 1 < end && static_cast<unsigned>(p[1] - '0') <= 8) ? static_cast<uint8_t>(p[1] - '0') : 0;
+                return true;
+            }
+
+            if (p < end && *p == '#') {
+                if (p + 1 >= end || hexDigit(p[1]) < 0) return false;
+                int flags = hexDigit(p[1]);
+                message.fd = true;
+                message.brs = (flags & 0x1) != 0;
+                message.esi = (flags & 0x2) != 0;
+                p += 2;
+            }
+
+            uint8_t payload[CANFD_MAX_DATA_LENGTH];
+            size_t length = 0;
+            size_t capacity = message.fd ? CANFD_MAX_DATA_LENGTH : CAN_MAX_DATA_LENGTH;
+            while (p + 1 < end) {
+                if (*p == '.') {                // optional byte separators (candump -ta style)
+                    ++p;
+                    continue;
+                }
+                int high = hexDigit(p[0]);
+                int low = hexDigit(p[1]);
+                if (high < 0 || low < 0) break;
+                if (length == capacity) return false;
+                payload[length++] = static_cast<uint8_t>(high << 4 | low);
+                p += 2;
+            }
+            // A leftover hex digit means an odd-length payload: the line is corrupt
+            if (p < end && hexDigit(*p) >= 0) return false;
+            if (message.fd && !validFdLength(length)) return false;
+
+            message.data.assign(span<const uint8_t>(payload, length));
+            message.dlc = message.fd ? canFdLengthToDlc(length) : static_cast<uint8_t>(length);
+            return true;
+        }
+
+        // ========================================
+        // Vector ASC
+        // ========================================
+
+        // One data byte in the header's number base
+        bool parseByte(const char*& p, const char* end, uint8_t& value) const {
+            p = skipSpaces(p, end);
+            const char* last = tokenEnd(p, end);
+            if (p == last) return false;
+            unsigned number = 0;
+            for (const char* c = p; c < last; ++c) {
+                int digit = decimalBase ? (static_cast<unsigned>(*c - '0') < 10 ? *c - '0' : -1) : hexDigit(*c);
+                if (digit < 0) return false;
+                number = number * (decimalBase ? 10 : 16) + digit;
+            }
+            if (number > 0xFF) return false;
+            value = static_cast<uint8_t>(number);
+            p = last;
+            return true;
+        }
+
+        // Identifier token: hex (or decimal) digits, 'x' suffix for 29-bit IDs
+        bool parseAscId(const char*& p, const char* end, uint32_t& id, bool& extended) const {
+            p = skipSpaces(p, end);
+            const char* last = tokenEnd(p, end);
+            auto [idEnd, error] = from_chars(p, last, id, decimalBase ? 10 : 16);
+            if (error != errc()) return false;
+            extended = idEnd < last && (*idEnd == 'x' || *idEnd == 'X');
+            if (idEnd + (extended ? 1 : 0) != last) return false;
+            p = last;
+            return validId(id, extended);
+        }
+
+        bool matchesChannel(const char* p, const char* last) const {
+            return channelFilter.empty() || string_view(p, last - p) == channelFilter;
+        }
+
+        // <time> <channel> <id>[x] Rx|Tx d <dlc> <bytes...>   (classic data)
+        // <time> <channel> <id>[x] Rx|Tx r [<dlc>]              (classic remote)
+        // <time> CANFD <channel> Rx|Tx <id>[x] [<name>] <brs> <esi> <dlc> <length> <bytes...>
+        // timeNs gets the leading time even when the rest of the line is
+        // rejected (error frames, other channels), since relative logs count
+        // from every event
+        bool parseAscLine(const char* p, const char* end, CANMessage& message, int64_t& timeNs) const {
+            p = skipSpaces(p, end);
+            if (!parseSeconds(p, end, timeNs)) return false;
+            p = skipSpaces(p, end);
+            const char* last = tokenEnd(p, end);
+            string_view kind(p, last - p);
+
+            uint32_t id;
+            bool extended;
+            if (kind == "CANFD") {
+                p = skipSpaces(last, end);
+                last = tokenEnd(p, end);
+                if (!matchesChannel(p, last)) return false;
+                p = tokenEnd(skipSpaces(last, end), end);     // direction
+                if (!parseAscId(p, end, id, extended)) return false;
+
+                // Optional symbolic name before the BRS/ESI flags
+                auto isFlag = [](const char* token, const char* tokenLast) {
+                    return tokenLast - token == 1 && (*token == '0' || *token == '1');
+                };
+                p = skipSpaces(p, end);
+                last = tokenEnd(p, end);
+                if (!isFlag(p, last)) {
+                    p = skipSpaces(last, end);
+                    last = tokenEnd(p, end);
+                    if (!isFlag(p, last)) return false;
+                }
+                message.brs = *p == '1';
+                p = skipSpaces(last, end);
+                last = tokenEnd(p, end);
+                if (!isFlag(p, last)) return false;
+                message.esi = *p == '1';
+                p = skipSpaces(last, end);
+
+                uint8_t dlc;
+                size_t length;
+                auto [dlcEnd, dlcError] = from_chars(p, end, dlc, 16);
+                if (dlcError != errc() || dlc > 15) return false;
+                p = skipSpaces(dlcEnd, end);
+                auto [lengthEnd, lengthError] = from_chars(p, end, length);
+                if (lengthError != errc() || !validFdLength(length)) return false;
+                p = lengthEnd;
+
+                message.fd = true;
+                message.dlc = canFdLengthToDlc(length);
+                message.data.resize(length);
+                for (size_t i = 0; i < length; ++i) {
+                    if (!parseByte(p, end, message.data[i])) return false;
+                }
+            } else {
+                if (kind.empty() || static_cast<unsigned>(kind[0] - '0') >= 10) return false;
+                if (!matchesChannel(p, last)) return false;
+                p = last;
+                if (!parseAscId(p, end, id, extended)) return false;      // fails on ErrorFrame, Statistic:, ...
+                p = tokenEnd(skipSpaces(p, end), end);        // direction
+                p = skipSpaces(p, end);
+                if (p == end) return false;
+                char type = *p;
+                p = skipSpaces(p + 1, end);
+
+                uint8_t dlc = 0;
+                auto [dlcEnd, dlcError] = from_chars(p, end, dlc, 16);
+                if (type == 'r') {
+                    message.rtr = true;
+                    message.frameType = CANFrameType::REMOTE_FRAME;
+                    message.dlc = dlcError == errc() ? min<uint8_t>(dlc, 8) : 0;
+                } else if (type == 'd') {
+                    if (dlcError != errc() || dlc > 15) return false;
+                    p = dlcEnd;
+                    size_t length = min<size_t>(dlc, CAN_MAX_DATA_LENGTH);
+                    message.data.resize(length);
+                    for (size_t i = 0; i < length; ++i) {
+                        if (!parseByte(p, end, message.data[i])) return false;
+                    }
+                    message.dlc = static_cast<uint8_t>(length);
+                } else {
+                    return false;
+                }
+            }
+
+            message.id = id;
+            message.format = extended ? CANFormat::EXTENDED : CANFormat::STANDARD;
+            message.timestamp = steady_clock::time_point(nanoseconds(timeNs));
+            return true;
+        }
+
+        // Reads "base hex|dec" and "timestamps absolute|relative" from the
+        // header; the body starts at the first line that begins with a number
+        void parseAscHeader() {
+            const char* text = reinterpret_cast<const char*>(file.data());
+            const char* end = text + file.size();
+            const char* line = text;
+            while (line < end) {
+                const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+                if (!lineEnd) lineEnd = end;
+                const char* p = skipSpaces(line, lineEnd);
+                if (p < lineEnd && static_cast<unsigned>(*p - '0') < 10) break;
+
+                string_view header(p, lineEnd - p);
+                if (header.starts_with("base")) {
+                    decimalBase = header.find(" dec") != string_view::npos;
+                    relativeTimestamps = header.find("timestamps relative") != string_view::npos;
+                }
+                ++headerLines;
+                line = lineEnd < end ? lineEnd + 1 : end;
+            }
+            bodyOffset = static_cast<size_t>(line - text);
+        }
+
+        CANLogFormat detectFormat() const {
+            const char* text = reinterpret_cast<const char*>(file.data());
+            const char* end = text + file.size();
+            const char* p = text;
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+            if (p < end && *p == '(') return CANLogFormat::CANDUMP;
+
+            string_view start(p, min<size_t>(end - p, 64));
+            if (start.starts_with("date") || start.starts_with("base") || start.starts_with("//") ||
+                start.starts_with("Begin") || (p < end && static_cast<unsigned>(*p - '0') < 10)) {
+                return CANLogFormat::VECTOR_ASC;
+            }
+            throw runtime_error("Unrecognized CAN log format: " + filePath);
+        }
+
+        // ========================================
+        // Chunked Parsing
+        // ========================================
+
+        // Line-aligned chunk boundaries of the log body
+        vector<Chunk> splitChunks() const {
+            const char* text = reinterpret_cast<const char*>(file.data());
+            vector<Chunk> chunks;
+            size_t begin = bodyOffset;
+            while (begin < file.size()) {
+                size_t end = min(begin + chunkSize, file.size());
+                if (end < file.size()) {
+                    const void* newline = memchr(text + end, '\n', file.size() - end);
+                    end = newline ? static_cast<size_t>(static_cast<const char*>(newline) - text) + 1 : file.size();
+                }
+                Chunk chunk;
+                chunk.begin = begin;
+                chunk.end = end;
+                chunks.push_back(std::move(chunk));
+                begin = end;
+            }
+            return chunks;
+        }
+
+        void parseChunk(Chunk& chunk) const {
+            const char* text = reinterpret_cast<const char*>(file.data());
+            const char* line = text + chunk.begin;
+            const char* end = text + chunk.end;
+            chunk.frames.reserve((chunk.end - chunk.begin) / 32);
+            chunk.stats.bytes = chunk.end - chunk.begin;
+
+            while (line < end) {
+                const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+                if (!lineEnd) lineEnd = end;
+
+                CANMessage message;
+                int64_t lineTimeNs = 0;
+                bool parsed = format == CANLogFormat::CANDUMP
+                    ? parseCandumpLine(line, lineEnd, message)
+                    : parseAscLine(line, lineEnd, message, lineTimeNs);
+                if (relativeTimestamps) {
+                    // Chunk-local until forEach adds the preceding chunks
+                    chunk.elapsedNs += lineTimeNs;
+                    message.timestamp = steady_clock::time_point(nanoseconds(chunk.elapsedNs));
+                }
+                if (parsed) {
+                    chunk.frames.push_back(message);
+                } else {
+                    ++chunk.stats.skippedLines;
+                }
+                ++chunk.stats.lines;
+                line = lineEnd + 1;
+            }
+            chunk.stats.frames = chunk.frames.size();
+        }
+
+    public:
+        static constexpr size_t DEFAULT_CHUNK_SIZE = 4 << 20;
+
+        explicit CANLogImporter(const string& path, CANLogFormat logFormat = CANLogFormat::AUTO,
+                                size_t threadCount = thread::hardware_concurrency())
+            : file(MappedFile::openForRead(path)), filePath(path), format(logFormat), pool(threadCount) {
+            if (format == CANLogFormat::AUTO) {
+                format = detectFormat();
+            }
+            if (format == CANLogFormat::VECTOR_ASC) {
+                parseAscHeader();
+            }
+        }
+
+        CANLogImporter(const CANLogImporter&) = delete;
+        CANLogImporter& operator=(const CANLogImporter&) = delete;
+
+        CANLogFormat getFormat() const { return format; }
+
+        void setChunkSize(size_t bytes) {
+            if (bytes == 0) throw invalid_argument("Chunk size must be positive");
+            chunkSize = bytes;
+        }
+
+        // Only frames of this candump interface ("can0") or ASC channel ("1")
+        void setChannelFilter(const string& channel) { channelFilter = channel; }
+
+        // Calls visitor(const CANMessage&) for every frame in file order.
+        // Chunks are parsed a pool-sized batch at a time, so memory stays
+        // bounded however large the file is.
+        template<typename Visitor>
+        LogImportStats forEach(Visitor&& visitor) {
+            LogImportStats total;
+            total.bytes = bodyOffset;
+            total.lines = headerLines;
+            total.skippedLines = headerLines;
+
+            vector<Chunk> chunks = splitChunks();
+            size_t batchSize = pool.size() * 2;
+            int64_t relativeTimeNs = 0;
+
+            for (size_t first = 0; first < chunks.size(); first += batchSize) {
+                size_t count = min(batchSize, chunks.size() - first);
+                pool.parallelFor(count, [&](size_t i) {
+                    parseChunk(chunks[first + i]);
+                });
+
+                for (size_t i = first; i < first + count; ++i) {
+                    Chunk& chunk = chunks[i];
+                    for (CANMessage& message : chunk.frames) {
+                        if (relativeTimestamps) {
+                            message.timestamp += nanoseconds(relativeTimeNs);
+                        }
+                        visitor(static_cast<const CANMessage&>(message));
+                    }
+                    relativeTimeNs += chunk.elapsedNs;
+                    total.bytes += chunk.stats.bytes;
+                    total.lines += chunk.stats.lines;
+                    total.frames += chunk.stats.frames;
+                    total.skippedLines += chunk.stats.skippedLines;
+                    chunk.frames = vector<CANMessage>();
+                }
+            }
+            return total;
+        }
+
+        vector<CANMessage> readAll() {
+            vector<CANMessage> frames;
+            forEach([&frames](const CANMessage& message) {
+                frames.push_back(message);
+            });
+            return frames;
+        }
+
+        // Writes the log as a binary trace (see TraceReader for replay)
+        LogImportStats convertToTrace(const string& tracePath) {
+            TraceRecorder recorder(tracePath);
+            LogImportStats stats = forEach([&recorder](const CANMessage& message) {
+                recorder.write(message);
+            });
+            recorder.close();
+            return stats;
+        }
+    };
+
+} // namespace CANSim
@@ -0,0 +1,86 @@
+// CANLogImportTest.cpp : Checks timestamps of a "timestamps relative" ASC log.
+// Each line's time is a delta from the previous event, whether or not that
+// event becomes a frame, so error frames, filtered channels and malformed
+// lines must still advance the clock. Exit code 1 on a mismatch.
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+import CANBusSimulation;
+import CANLogImport;
+
+using namespace std;
+using namespace std::chrono;
+using namespace CANSim;
+
+namespace {
+
+    constexpr const char* RELATIVE_ASC =
+        "date Fri Oct 16 10:00:00.000 am 2026\n"
+        "base hex  timestamps relative\n"
+        "Begin Triggerblock Fri Oct 16 10:00:00.000 am 2026\n"
+        "0.000000 Start of measurement\n"
+        "0.010000 1  100  Rx  d 2 01 02\n"
+        "0.005000 1  ErrorFrame\n"
+        "0.002000 2  200  Rx  d 1 AA\n"
+        "0.003000 CANFD   2 Rx 300  1 0 8 8 00 00 00 00 00 00 00 00\n"
+        "0.004000 1  101  Rx  d 1 03\n"
+        "0.001000 1  1G0  Rx  d 1 03\n"
+        "0.020000 1  102  Rx  d 1 04\n"
+        "End TriggerBlock\n";
+
+    struct Expected {
+        uint32_t id;
+        milliseconds time;
+    };
+
+    size_t check(const string& path, const string& channel, size_t chunkSize, const vector<Expected>& expected) {
+        CANLogImporter log(path, CANLogFormat::VECTOR_ASC, 2);
+        log.setChunkSize(chunkSize);
+        log.setChannelFilter(channel);
+        vector<CANMessage> frames = log.readAll();
+
+        string label = "channel '" + channel + "', chunk " + to_string(chunkSize);
+        if (frames.size() != expected.size()) {
+            cerr << "FAIL (" << label << "): " << frames.size() << " frames, expected " << expected.size() << endl;
+            return 1;
+        }
+        size_t failures = 0;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            auto time = duration_cast<microseconds>(frames[i].timestamp.time_since_epoch());
+            if (frames[i].id != expected[i].id || time != expected[i].time) {
+                cerr << "FAIL (" << label << "): frame " << i << " is 0x" << hex << frames[i].id << dec
+                     << " at " << time.count() << " us, expected 0x" << hex << expected[i].id << dec
+                     << " at " << microseconds(expected[i].time).count() << " us" << endl;
+                ++failures;
+            }
+        }
+        return failures;
+    }
+
+}
+
+int main() {
+    string path = (filesystem::temp_directory_path() / "can_log_import_test.asc").string();
+    ofstream(path, ios::binary) << RELATIVE_ASC;
+
+    size_t failures = 0;
+    // Small chunks put the skipped lines in other chunks than the frames after them
+    for (size_t chunkSize : {size_t(4096), size_t(16)}) {
+        failures += check(path, "", chunkSize, {{0x100, 10ms}, {0x200, 17ms}, {0x300, 20ms}, {0x101, 24ms}, {0x102, 45ms}});
+        failures += check(path, "1", chunkSize, {{0x100, 10ms}, {0x101, 24ms}, {0x102, 45ms}});
+        failures += check(path, "2", chunkSize, {{0x200, 17ms}, {0x300, 20ms}});
+    }
+    filesystem::remove(path);
+
+    if (failures != 0) {
+        cerr << failures << " relative timestamps are wrong" << endl;
+        return 1;
+    }
+    cout << "PASS" << endl;
+    return 0;
+}
@@ -0,0 +1,465 @@
+// CANLogging.ixx - Asynchronous Structured Logging for the CAN Simulation
+// Log calls on the bus hot path only copy a fixed-size binary record into a
+// per-thread lock-free ring; a background thread formats and prints them.
+// A full ring makes the caller wait for the writer (or, if configured, drops
+// the record), so no output is lost by default.
+// Levels below CANSIM_LOG_LEVEL are removed at compile time.
+
+module;
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <bit>
+#include <cstring>
+#include <cstdio>
+
+// Minimum compiled-in level: 0=TRACE 1=DEBUG 2=INFO 3=WARNING 4=ERROR 5=OFF
+// (e.g. define CANSIM_LOG_LEVEL=2 to strip the per-frame DEBUG traces)
+#ifndef CANSIM_LOG_LEVEL
+#define CANSIM_LOG_LEVEL 1
+#endif
+
+export module CANLogging;
+
+using namespace std;
+using namespace std::chrono;
+
+export namespace CANSim {
+
+    // ========================================
+    // Log Levels and Sources
+    // ========================================
+
+    enum class LogLevel : uint8_t {
+        TRACE = 0,
+        DEBUG = 1,      // Per-frame traces
+        INFO = 2,       // Configuration and state changes
+        WARNING = 3,
+        ERROR = 4,
+        OFF = 5
+    };
+
+    // Printed as the "[TAG]" prefix of each line
+    enum class LogTag : uint8_t {
+        BUS = 0,
+        CTRL = 1,
+        ECU = 2,
+        VEHICLE = 3,
+        DASH = 4,
+        APP = 5,
+        GATEWAY = 6
+    };
+
+    constexpr LogLevel COMPILED_LOG_LEVEL = static_cast<LogLevel>(CANSIM_LOG_LEVEL);
+
+    // What a log call does when its thread's ring is full
+    enum class LogOverflowPolicy : uint8_t {
+        BLOCK = 0,      // Wait until the writer thread drains the ring (lossless)
+        DROP = 1        // Discard the record and count it; the caller never waits
+    };
+
+    // ========================================
+    // Binary Log Record
+    // ========================================
+
+    // One log event. Arguments are stored raw and only turned into text by
+    // the background writer. Types with a formatTo(char*, size_t) member that
+    // are trivially copyable (e.g. CANMessage) are stored by value.
+    struct LogRecord {
+        static constexpr size_t MAX_ARGS = 6;
+        static constexpr size_t STORAGE_BYTES = 104;
+
+        enum class ArgKind : uint8_t {
+            SIGNED = 0,
+            UNSIGNED = 1,
+            FLOATING = 2,
+            BOOLEAN = 3,
+            TEXT = 4,       // value = offset | (length << 16) into storage
+            OBJECT = 5      // value = offset into storage
+        };
+
+        using ObjectFormatter = size_t (*)(const void* object, char* buffer, size_t bufferSize);
+
+        int64_t timestampNs;                // steady_clock, used to merge threads
+        const char* format;                 // string literal with {} / {:x} / {:X} placeholders
+        ObjectFormatter objectFormatter;    // formats the single OBJECT argument
+        LogLevel level;
+        LogTag tag;
+        uint8_t argCount;
+        uint8_t storageUsed;
+        array<ArgKind, MAX_ARGS> kinds;
+        array<uint64_t, MAX_ARGS> values;
+        alignas(8) array<char, STORAGE_BYTES> storage;
+    };
+
+    // ========================================
+    // Logger (per-thread rings + background writer)
+    // ========================================
+
+    class Logger {
+    private:
+        static constexpr size_t RECORDS_PER_THREAD = 4096;
+
+        // Single-producer/single-consumer ring owned by one logging thread
+        struct ThreadBuffer {
+            unique_ptr<LogRecord[]> records = make_unique<LogRecord[]>(RECORDS_PER_THREAD);
+            alignas(64) atomic<uint64_t> writeIndex{0};
+            alignas(64) atomic<uint64_t> readIndex{0};
+            atomic<bool> retired{false};
+        };
+
+        // Registers the calling thread's buffer on first use and retires it at thread exit
+        struct BufferHandle {
+            shared_ptr<ThreadBuffer> buffer = make_shared<ThreadBuffer>();
+
+            explicit BufferHandle(Logger& logger) {
+                lock_guard<mutex> lock(logger.registryMutex);
+                logger.buffers.push_back(buffer);
+            }
+            ~BufferHandle() { buffer->retired.store(true, memory_order_release); }
+        };
+
+        mutex registryMutex;
+        vector<shared_ptr<ThreadBuffer>> buffers;
+
+        mutex writerMutex;
+        condition_variable writerCondition;
+        thread writerThread;
+        atomic<bool> running{true};
+        uint64_t flushRequested = 0;       // guarded by writerMutex
+        uint64_t flushCompleted = 0;       // guarded by writerMutex
+
+        ostream* output = &cout;           // guarded by writerMutex
+        atomic<LogLevel> runtimeLevel{LogLevel::TRACE};
+        atomic<LogOverflowPolicy> overflowPolicy{LogOverflowPolicy::BLOCK};
+        atomic<uint64_t> droppedRecords{0};
+        uint64_t reportedDrops = 0;        // writer thread only
+
+        Logger() {
+            writerThread = thread(&Logger::writerLoop, this);
+        }
+
+        ~Logger() {
+            {
+                lock_guard<mutex> lock(writerMutex);
+                running.store(false);
+            }
+            writerCondition.notify_all();
+            if (writerThread.joinable()) {
+                writerThread.join();
+            }
+        }
+
+        ThreadBuffer& localBuffer() {
+            thread_local BufferHandle handle(*this);
+            return *handle.buffer;
+        }
+
+        // ---- Argument encoding (producer side) ----
+
+        template<typename T>
+        static size_t formatObject(const void* object, char* buffer, size_t bufferSize) {
+            return static_cast<const T*>(object)->formatTo(buffer, bufferSize);
+        }
+
+        static void encodeText(LogRecord& record, size_t index, string_view text) {
+            size_t length = min(text.size(), LogRecord::STORAGE_BYTES - record.storageUsed);
+            memcpy(record.storage.data() + record.storageUsed, text.data(), length);
+            record.kinds[index] = LogRecord::ArgKind::TEXT;
+            record.values[index] = record.storageUsed | (uint64_t(length) << 16);
+            record.storageUsed = static_cast<uint8_t>(record.storageUsed + length);
+        }
+
+        template<typename T>
+        static void encodeArgument(LogRecord& record, size_t index, const T& value) {
+            using Type = decay_t<T>;
+            if constexpr (is_same_v<Type, bool>) {
+                record.kinds[index] = LogRecord::ArgKind::BOOLEAN;
+                record.values[index] = value ? 1 : 0;
+            } else if constexpr (is_enum_v<Type>) {
+                encodeArgument(record, index, static_cast<underlying_type_t<Type>>(value));
+            } else if constexpr (is_integral_v<Type> && is_signed_v<Type>) {
+                record.kinds[index] = LogRecord::ArgKind::SIGNED;
+                record.values[index] = static_cast<uint64_t>(static_cast<int64_t>(value));
+            } else if constexpr (is_integral_v<Type>) {
+                record.kinds[index] = LogRecord::ArgKind::UNSIGNED;
+                record.values[index] = static_cast<uint64_t>(value);
+            } else if constexpr (is_floating_point_v<Type>) {
+                record.kinds[index] = LogRecord::ArgKind::FLOATING;
+                record.values[index] = bit_cast<uint64_t>(static_cast<double>(value));
+            } else if constexpr (is_convertible_v<const T&, string_view>) {
+                encodeText(record, index, string_view(value));
+            } else {
+                static_assert(is_trivially_copyable_v<Type>,
+                              "Log arguments must be numbers, text or trivially copyable types with formatTo()");
+                size_t offset = (record.storageUsed + 7u) & ~size_t(7);
+                if (record.objectFormatter != nullptr || offset + sizeof(Type) > LogRecord::STORAGE_BYTES) {
+                    encodeText(record, index, "<?>");
+                    return;
+                }
+                memcpy(record.storage.data() + offset, &value, sizeof(Type));
+                record.kinds[index] = LogRecord::ArgKind::OBJECT;
+                record.values[index] = offset;
+                record.objectFormatter = &formatObject<Type>;
+                record.storageUsed = static_cast<uint8_t>(offset + sizeof(Type));
+            }
+        }
+
+        // ---- Formatting (writer side) ----
+
+        static void appendArgument(string& out, const LogRecord& record, size_t index, char spec) {
+            uint64_t value = record.values[index];
+            char number[32];
+            int length = 0;
+
+            switch (record.kinds[index]) {
+                case LogRecord::ArgKind::SIGNED:
+                    length = snprintf(number, sizeof(number), spec ? (spec == 'X' ? "%llX" : "%llx") : "%lld",
+                                      static_cast<long long>(static_cast<int64_t>(value)));
+                    break;
+                case LogRecord::ArgKind::UNSIGNED:
+                    length = snprintf(number, sizeof(number), spec ? (spec == 'X' ? "%llX" : "%llx") : "%llu",
+                                      static_cast<unsigned long long>(value));
+                    break;
+                case LogRecord::ArgKind::FLOATING:
+                    length = snprintf(number, sizeof(number), "%g", bit_cast<double>(value));
+                    break;
+                case LogRecord::ArgKind::BOOLEAN:
+                    out += value ? "true" : "false";
+                    return;
+                case LogRecord::ArgKind::TEXT:
+                    out.append(record.storage.data() + (value & 0xFFFF), static_cast<size_t>(value >> 16));
+                    return;
+                case LogRecord::ArgKind::OBJECT: {
+                    // Copy back to aligned storage before handing it to the formatter
+                    alignas(16) char object[LogRecord::STORAGE_BYTES];
+                    memcpy(object, record.storage.data() + value, LogRecord::STORAGE_BYTES - value);
+                    char text[512];
+                    size_t textLength = record.objectFormatter(object, text, sizeof(text));
+                    out.append(text, textLength);
+                    return;
+                }
+            }
+            out.append(number, static_cast<size_t>(max(length, 0)));
+        }
+
+        static const char* tagName(LogTag tag) {
+            switch (tag) {
+                case LogTag::BUS: return "[BUS] ";
+                case LogTag::CTRL: return "[CTRL] ";
+                case LogTag::ECU: return "[ECU] ";
+                case LogTag::VEHICLE: return "[VEHICLE] ";
+                case LogTag::DASH: return "[DASH] ";
+                case LogTag::APP: return "[APP] ";
+                case LogTag::GATEWAY: return "[GW] ";
+            }
+            return "[?] ";
+        }
+
+        static void formatRecord(string& out, const LogRecord& record) {
+            out += tagName(record.tag);
+            if (record.level == LogLevel::WARNING) out += "WARNING: ";
+            if (record.level == LogLevel::ERROR) out += "ERROR: ";
+
+            size_t argument = 0;
+            for (const char* p = record.format; *p; ++p) {
+                if (*p == '{') {
+                    const char* close = strchr(p, '}');
+                    if (close && argument < record.argCount) {
+                        char spec = (close - p == 3 && p[1] == ':') ? p[2] : 0;
+                        appendArgument(out, record, argument++, spec);
+                        p = close;
+                        continue;
+                    }
+                }
+                out += *p;
+            }
+            out += '\n';
+        }
+
+        // Moves every available record out of the per-thread rings
+        void collect(vector<LogRecord>& batch) {
+            lock_guard<mutex> lock(registryMutex);
+            for (auto it = buffers.begin(); it != buffers.end();) {
+                ThreadBuffer& buffer = **it;
+                bool retired = buffer.retired.load(memory_order_acquire);
+                uint64_t read = buffer.readIndex.load(memory_order_relaxed);
+                uint64_t write = buffer.writeIndex.load(memory_order_acquire);
+                for (; read != write; ++read) {
+                    batch.push_back(buffer.records[read & (RECORDS_PER_THREAD - 1)]);
+                }
+                buffer.readIndex.store(read, memory_order_release);
+
+                if (retired) {
+                    it = buffers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        void writerLoop() {
+            vector<LogRecord> batch;
+            string text;
+            batch.reserve(RECORDS_PER_THREAD);
+
+            for (;;) {
+                uint64_t flushTarget;
+                bool stopping;
+                {
+                    lock_guard<mutex> lock(writerMutex);
+                    flushTarget = flushRequested;
+                    stopping = !running.load();
+                }
+
+                batch.clear();
+                collect(batch);
+                if (!batch.empty()) {
+                    // Merge the threads' records into time order
+                    stable_sort(batch.begin(), batch.end(), [](const LogRecord& a, const LogRecord& b) {
+                        return a.timestampNs < b.timestampNs;
+                    });
+                    text.clear();
+                    for (const auto& record : batch) {
+                        formatRecord(text, record);
+                    }
+                }
+
+                uint64_t dropped = droppedRecords.load(memory_order_relaxed);
+                if (dropped != reportedDrops) {
+                    text += "[LOG] WARNING: " + to_string(dropped - reportedDrops) + " records dropped (ring full)\n";
+                    reportedDrops = dropped;
+                }
+
+                unique_lock<mutex> lock(writerMutex);
+                if (!text.empty()) {
+                    output->write(text.data(), static_cast<streamsize>(text.size()));
+                    output->flush();
+                    text.clear();
+                }
+                if (batch.empty()) {
+                    if (flushCompleted < flushTarget) {
+                        flushCompleted = flushTarget;
+                        writerCondition.notify_all();
+                    }
+                    if (stopping) break;
+                    writerCondition.wait_for(lock, 1ms);
+                }
+            }
+        }
+
+    public:
+        static Logger& instance() {
+            static Logger logger;
+            return logger;
+        }
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        // Producer hot path: fills a record in place without allocating. It
+        // only waits when the ring is full under LogOverflowPolicy::BLOCK.
+        template<typename... Args>
+        void write(LogLevel level, LogTag tag, const char* format, const Args&... args) {
+            static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "Too many log arguments");
+            if (level < runtimeLevel.load(memory_order_relaxed)) return;
+
+            ThreadBuffer& buffer = localBuffer();
+            uint64_t write = buffer.writeIndex.load(memory_order_relaxed);
+            while (write - buffer.readIndex.load(memory_order_acquire) >= RECORDS_PER_THREAD) {
+                // Dropping is the only option once the writer has stopped
+                if (overflowPolicy.load(memory_order_relaxed) == LogOverflowPolicy::DROP || !running.load()) {
+                    droppedRecords.fetch_add(1, memory_order_relaxed);
+                    return;
+                }
+                writerCondition.notify_all();
+                this_thread::yield();
+            }
+
+            LogRecord& record = buffer.records[write & (RECORDS_PER_THREAD - 1)];
+            record.timestampNs = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+            record.format = format;
+            record.objectFormatter = nullptr;
+            record.level = level;
+            record.tag = tag;
+            record.argCount = static_cast<uint8_t>(sizeof...(Args));
+            record.storageUsed = 0;
+            size_t index = 0;
+            (encodeArgument(record, index++, args), ...);
+
+            buffer.writeIndex.store(write + 1, memory_order_release);
+        }
+
+        // Blocks until everything logged before the call has been printed
+        void flush() {
+            unique_lock<mutex> lock(writerMutex);
+            uint64_t target = ++flushRequested;
+            writerCondition.notify_all();
+            writerCondition.wait(lock, [this, target] { return flushCompleted >= target || !running.load(); });
+        }
+
+        void setOutput(ostream& stream) {
+            lock_guard<mutex> lock(writerMutex);
+            output = &stream;
+        }
+
+        // Runtime filter on top of COMPILED_LOG_LEVEL
+        void setLevel(LogLevel level) { runtimeLevel.store(level, memory_order_relaxed); }
+        LogLevel getLevel() const { return runtimeLevel.load(memory_order_relaxed); }
+
+        void setOverflowPolicy(LogOverflowPolicy policy) { overflowPolicy.store(policy, memory_order_relaxed); }
+        LogOverflowPolicy getOverflowPolicy() const { return overflowPolicy.load(memory_order_relaxed); }
+        uint64_t getDroppedRecords() const { return droppedRecords.load(memory_order_relaxed); }
+    };
+
+    // ========================================
+    // Logging Front End
+    // ========================================
+
+    // Levels below COMPILED_LOG_LEVEL compile to nothing. Pass raw values
+    // (numbers, text, CANMessage) rather than pre-formatted strings so that a
+    // disabled call does no work at the call site either.
+    template<LogLevel Level, typename... Args>
+    inline void log(LogTag tag, const char* format, const Args&... args) {
+        if constexpr (Level != LogLevel::OFF && Level >= COMPILED_LOG_LEVEL) {
+            Logger::instance().write(Level, tag, format, args...);
+        }
+    }
+
+    template<typename... Args>
+    inline void logTrace(LogTag tag, const char* format, const Args&... args) {
+        log<LogLevel::TRACE>(tag, format, args...);
+    }
+
+    template<typename... Args>
+    inline void logDebug(LogTag tag, const char* format, const Args&... args) {
+        log<LogLevel::DEBUG>(tag, format, args...);
+    }
+
+    template<typename... Args>
+    inline void logInfo(LogTag tag, const char* format, const Args&... args) {
+        log<LogLevel::INFO>(tag, format, args...);
+    }
+
+    template<typename... Args>
+    inline void logWarning(LogTag tag, const char* format, const Args&... args) {
+        log<LogLevel::WARNING>(tag, format, args...);
+    }
+
+    template<typename... Args>
+    inline void logError(LogTag tag, const char* format, const Args&... args) {
+        log<LogLevel::ERROR>(tag, format, args...);
+    }
+
+} // namespace CANSim
@@ -25,6 +25,16 @@ int main()
 	// Run the basic CAN demo by default
 	CANDemo::runBasicCANDemo();
 	//CANDemo::IndustrialCANDemo::runFactoryAutomationDemo();
+	//CANDemo::IndustrialCANDemo::runFactoryAutomationDemo(CANSim::TimeMode::VIRTUAL_TIME); // same run, simulated clock
+	//CANDemo::runFleetDemo(100); // 100 virtual buses on a shared worker pool
+	//CANDemo::runGatewayDemo(); // three buses joined by a routing gateway
+	//CANDemo::runErrorStormDemo(); // fault confinement under bus noise and faulty nodes
+	//CANDemo::runCANFDDemo(); // classic vs CAN FD payload throughput
+	//CANDemo::runTraceDemo(); // record a saturated bus to a trace file and replay it
+	//CANDemo::runLogImportDemo("capture.log"); // import a candump/ASC field log and replay it
+	//CANDemo::runBatchDecodeDemo(); // decode a signal column from a trace, per frame vs SIMD
+	//CANDemo::runLatencyDemo(); // per-ID latency histograms of a 20 Hz control frame under load
+	//CANDemo::runLoadSweepDemo(); // synthetic ECU traffic swept from 20% to 110% bus load
 
 	cout << "\n\033[1;33m ****** NEW: Simple Headlight Control Demo ****** \033[0m \n";
 	cout << "Running simple automotive headlight control scenario..." << endl;
@@ -37,7 +47,12 @@ int main()
 
 	// Run the new Adaptive Cruise Control scenario
 	//AdaptiveCruiseControl::AdaptiveCruiseControlScenario cruiseControlDemo;
+	//CANSim::SimulationSeed::set(42); // deterministic mode: with the line below every run prints the same run hash
+	//AdaptiveCruiseControl::AdaptiveCruiseControlScenario cruiseControlDemo(CANSim::TimeMode::VIRTUAL_TIME);
 	//cruiseControlDemo.runScenario();
+	//AdaptiveCruiseControl::CoroutineCruiseControl::runFleet(1000); // coroutine ECU/vehicle pairs on a worker pool
+	//AdaptiveCruiseControl::CruiseControlMonteCarlo::runBatch(2000); // gains, mass, roads and noise varied on all cores
+	//AdaptiveCruiseControl::PIGainTuner::runAutoTune(); // grid-refined Kp/Ki over all road profiles, no CAN bus
 
 	cout << "\n\nFor more detailed learning, uncomment the other demo functions in Main.cpp:" << endl;
 	cout << "// CANDemo::runArbitrationDemo();" << endl;
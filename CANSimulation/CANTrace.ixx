@@ -0,0 +1,691 @@
+// CANTrace.ixx - Binary Trace Recording and Replay
+// Captures every frame delivered on a bus into a compact fixed-size binary
+// file, and replays such files into a bus (at the recorded timing or as fast
+// as the bus accepts frames) or straight into analysis code.
+
+module;
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+export module CANTrace;
+
+import CANBusSimulation;
+
+using namespace std;
+using namespace std::chrono;
+
+export namespace CANSim {
+
+    // ========================================
+    // Memory-Mapped File
+    // ========================================
+
+    // Whole-file mapping: read-only for replay, or read-write and growable
+    // for recording. Not thread-safe.
+    class MappedFile {
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int descriptor = -1;
+#endif
+        uint8_t* view = nullptr;
+        size_t length = 0;
+        bool writable = false;
+
+        [[noreturn]] static void fail(const string& what, const string& path) {
+            throw runtime_error(what + ": " + path);
+        }
+
+        void unmap() {
+            if (!view) return;
+#ifdef _WIN32
+            UnmapViewOfFile(view);
+            CloseHandle(mapping);
+            mapping = nullptr;
+#else
+            munmap(view, length);
+#endif
+            view = nullptr;
+        }
+
+        // Maps the first 'bytes' of the file; a writable mapping extends the file first
+        void map(size_t bytes, const string& path) {
+            length = bytes;
+            if (bytes == 0) return;
+#ifdef _WIN32
+            LARGE_INTEGER size;
+            size.QuadPart = static_cast<LONGLONG>(bytes);
+            mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                         static_cast<DWORD>(size.HighPart), size.LowPart, nullptr);
+            if (!mapping) fail("Cannot map trace file", path);
+            view = static_cast<uint8_t*>(MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, bytes));
+#else
+            if (writable && ftruncate(descriptor, static_cast<off_t>(bytes)) != 0) fail("Cannot grow trace file", path);
+            void* address = mmap(nullptr, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, descriptor, 0);
+            view = address == MAP_FAILED ? nullptr : static_cast<uint8_t*>(address);
+#endif
+            if (!view) fail("Cannot map trace file", path);
+        }
+
+        void setFileSize(size_t bytes) {
+#ifdef _WIN32
+            LARGE_INTEGER size;
+            size.QuadPart = static_cast<LONGLONG>(bytes);
+            SetFilePointerEx(file, size, nullptr, FILE_BEGIN);
+            SetEndOfFile(file);
+#else
+            if (ftruncate(descriptor, static_cast<off_t>(bytes)) != 0) {
+                // Harmless: readers stop at the header's record count
+                logWarning(LogTag::BUS, "Cannot truncate trace file {}", filePath);
+            }
+#endif
+        }
+
+        string filePath;
+
+    public:
+        MappedFile() = default;
+
+        static MappedFile openForRead(const string& path) {
+            MappedFile result;
+            result.filePath = path;
+#ifdef _WIN32
+            result.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (result.file == INVALID_HANDLE_VALUE) fail("Cannot open trace file", path);
+            LARGE_INTEGER size;
+            GetFileSizeEx(result.file, &size);
+            result.map(static_cast<size_t>(size.QuadPart), path);
+#else
+            result.descriptor = ::open(path.c_str(), O_RDONLY);
+            if (result.descriptor < 0) fail("Cannot open trace file", path);
+            struct stat info;
+            fstat(result.descriptor, &info);
+            result.map(static_cast<size_t>(info.st_size), path);
+            if (result.view) madvise(result.view, result.length, MADV_SEQUENTIAL);
+#endif
+            return result;
+        }
+
+        static MappedFile create(const string& path, size_t initialBytes) {
+            MappedFile result;
+            result.filePath = path;
+            result.writable = true;
+#ifdef _WIN32
+            result.file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                      CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (result.file == INVALID_HANDLE_VALUE) fail("Cannot create trace file", path);
+#else
+            result.descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (result.descriptor < 0) fail("Cannot create trace file", path);
+#endif
+            result.map(initialBytes, path);
+            return result;
+        }
+
+        MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this != &other) {
+                close();
+#ifdef _WIN32
+                file = exchange(other.file, INVALID_HANDLE_VALUE);
+                mapping = exchange(other.mapping, nullptr);
+#else
+                descriptor = exchange(other.descriptor, -1);
+#endif
+                view = exchange(other.view, nullptr);
+                length = exchange(other.length, 0);
+                writable = other.writable;
+                filePath = std::move(other.filePath);
+            }
+            return *this;
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() { close(); }
+
+        // Remaps a writable file at a new size (contents up to the old size are kept)
+        void resize(size_t bytes) {
+            if (!writable) throw logic_error("Cannot resize a read-only mapping");
+            unmap();
+            map(bytes, filePath);
+        }
+
+        // Unmaps; a writable file is cut to 'finalSize' bytes if given
+        void close(optional<size_t> finalSize = nullopt) {
+            unmap();
+#ifdef _WIN32
+            if (file != INVALID_HANDLE_VALUE) {
+                if (writable && finalSize) setFileSize(*finalSize);
+                CloseHandle(file);
+                file = INVALID_HANDLE_VALUE;
+            }
+#else
+            if (descriptor >= 0) {
+                if (writable && finalSize) setFileSize(*finalSize);
+                ::close(descriptor);
+                descriptor = -1;
+            }
+#endif
+            length = 0;
+        }
+
+        uint8_t* data() { return view; }
+        const uint8_t* data() const { return view; }
+        size_t size() const { return length; }
+    };
+
+    // ========================================
+    // Trace File Format
+    // ========================================
+
+    // A 64-byte header followed by 24-byte records, little-endian. A frame
+    // is one record holding the first 8 payload bytes plus, for CAN FD,
+    // continuation records carrying 24 more payload bytes each. Times are
+    // deltas from the previous frame in nanoseconds; a delta that does not
+    // fit 32 bits is preceded by a time extension record.
+    struct TraceFileHeader {
+        static constexpr char MAGIC[8] = {'C', 'A', 'N', 'T', 'R', 'A', 'C', 'E'};
+        static constexpr uint32_t VERSION = 1;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;
+        int64_t startTimeNs;            // bus time of the first frame (steady_clock epoch)
+        uint64_t frameCount;
+        uint64_t recordCount;           // including continuation and extension records
+        uint8_t reserved[24];
+    };
+
+    struct TraceRecord {
+        static constexpr uint32_t ID_MASK = 0x1FFFFFFF;
+        static constexpr uint32_t EXTENDED = 1u << 29;
+        static constexpr uint32_t REMOTE = 1u << 30;
+        static constexpr uint32_t FD = 1u << 31;
+
+        static constexpr uint8_t BRS = 1u << 0;
+        static constexpr uint8_t ESI = 1u << 1;
+        static constexpr uint8_t TIME_EXTENSION = 1u << 7;    // data holds a 64-bit delta
+
+        static constexpr size_t INLINE_BYTES = 8;
+        static constexpr size_t CONTINUATION_BYTES = 24;
+
+        uint32_t timeDelta;             // ns since the previous frame
+        uint32_t idFlags;               // ID | EXTENDED | REMOTE | FD
+        uint8_t dlc;
+        uint8_t flags;
+        uint16_t continuations;         // records that follow with payload bytes 8..63
+        uint32_t nodeId;
+        uint8_t data[INLINE_BYTES];
+
+        static size_t continuationsFor(size_t payloadBytes) {
+            return payloadBytes > INLINE_BYTES
+                ? (payloadBytes - INLINE_BYTES + CONTINUATION_BYTES - 1) / CONTINUATION_BYTES : 0;
+        }
+    };
+
+    static_assert(sizeof(TraceFileHeader) == 64);
+    static_assert(sizeof(TraceRecord) == 24 && sizeof(TraceRecord) == TraceRecord::CONTINUATION_BYTES);
+
+    // ========================================
+    // Trace Recorder
+    // ========================================
+
+    // Records every frame delivered on one bus. The bus thread only encodes
+    // each frame into a lock-free single-producer ring (frames are dropped
+    // and counted when it is full, never waited for); a background thread
+    // copies the ring into the memory-mapped file.
+    //
+    //     TraceRecorder recorder("drive.cantrace");
+    //     recorder.attach(canBus);
+    //     ...
+    //     recorder.close();
+    class TraceRecorder {
+    private:
+        static constexpr size_t FILE_GROWTH = 64 << 20;
+
+        MappedFile file;
+        size_t fileUsed = sizeof(TraceFileHeader);      // writer thread only
+
+        unique_ptr<TraceRecord[]> ring;
+        size_t ringMask;
+        alignas(64) atomic<uint64_t> writeIndex{0};
+        alignas(64) atomic<uint64_t> readIndex{0};
+
+        // Producer (bus thread) state
+        int64_t lastTimeNs = 0;
+        bool started = false;
+        atomic<int64_t> startTimeNs{0};
+        atomic<uint64_t> recordedFrames{0};
+        atomic<uint64_t> droppedFrames{0};
+        uint64_t writtenRecords = 0;                    // writer thread only
+
+        weak_ptr<CANBus> attachedBus;
+        uint64_t observerId = 0;
+
+        thread writerThread;
+        mutex writerMutex;
+        condition_variable writerCondition;
+        bool running = true;                            // guarded by writerMutex
+        bool closed = false;
+
+        // Bus thread: encodes one frame. A full ring drops the frame, or with
+        // 'waitForSpace' (offline writes) waits for the writer thread.
+        void record(const CANMessage& message, steady_clock::time_point completed, bool waitForSpace = false) {
+            int64_t timeNs = duration_cast<nanoseconds>(completed.time_since_epoch()).count();
+            if (!started) {
+                startTimeNs.store(timeNs, memory_order_relaxed);
+                lastTimeNs = timeNs;
+                started = true;
+            }
+            uint64_t delta = static_cast<uint64_t>(max<int64_t>(timeNs - lastTimeNs, 0));
+            bool extended = delta >= UINT32_MAX;
+            size_t payloadBytes = message.data.size();
+            size_t continuations = TraceRecord::continuationsFor(payloadBytes);
+            size_t needed = 1 + continuations + (extended ? 1 : 0);
+
+            uint64_t write = writeIndex.load(memory_order_relaxed);
+            while (write + needed - readIndex.load(memory_order_acquire) > ringMask + 1) {
+                if (!waitForSpace) {
+                    droppedFrames.fetch_add(1, memory_order_relaxed);
+                    return;
+                }
+                writerCondition.notify_one();
+                this_thread::yield();
+            }
+
+            if (extended) {
+                TraceRecord& extension = ring[write++ & ringMask];
+                extension = TraceRecord{};
+                extension.timeDelta = UINT32_MAX;
+                extension.flags = TraceRecord::TIME_EXTENSION;
+                memcpy(extension.data, &delta, sizeof(delta));
+                delta = 0;
+            }
+
+            TraceRecord& record = ring[write++ & ringMask];
+            record.timeDelta = static_cast<uint32_t>(delta);
+            record.idFlags = (message.id & TraceRecord::ID_MASK)
+                           | (message.format == CANFormat::EXTENDED ? TraceRecord::EXTENDED : 0)
+                           | (message.rtr ? TraceRecord::REMOTE : 0)
+                           | (message.fd ? TraceRecord::FD : 0);
+            record.dlc = message.dlc;
+            record.flags = (message.brs ? TraceRecord::BRS : 0) | (message.esi ? TraceRecord::ESI : 0);
+            record.continuations = static_cast<uint16_t>(continuations);
+            record.nodeId = message.nodeId;
+            const uint8_t* payload = message.data.data();
+            size_t inlineBytes = min(payloadBytes, TraceRecord::INLINE_BYTES);
+            memcpy(record.data, payload, inlineBytes);
+            memset(record.data + inlineBytes, 0, TraceRecord::INLINE_BYTES - inlineBytes);
+
+            for (size_t offset = TraceRecord::INLINE_BYTES; offset < payloadBytes; offset += TraceRecord::CONTINUATION_BYTES) {
+                auto* bytes = reinterpret_cast<uint8_t*>(&ring[write++ & ringMask]);
+                size_t chunk = min(payloadBytes - offset, TraceRecord::CONTINUATION_BYTES);
+                memcpy(bytes, payload + offset, chunk);
+                memset(bytes + chunk, 0, TraceRecord::CONTINUATION_BYTES - chunk);
+            }
+
+            writeIndex.store(write, memory_order_release);
+            lastTimeNs = timeNs;
+            recordedFrames.fetch_add(1, memory_order_relaxed);
+        }
+
+        // Writer thread: copies everything queued into the file
+        void drain() {
+            uint64_t read = readIndex.load(memory_order_relaxed);
+            uint64_t write = writeIndex.load(memory_order_acquire);
+            if (read == write) return;
+
+            size_t bytes = static_cast<size_t>(write - read) * sizeof(TraceRecord);
+            if (fileUsed + bytes > file.size()) {
+                file.resize(max(fileUsed + bytes, file.size() + FILE_GROWTH));
+            }
+
+            // At most two contiguous pieces of the ring
+            while (read != write) {
+                size_t start = static_cast<size_t>(read & ringMask);
+                size_t count = min<size_t>(static_cast<size_t>(write - read), ringMask + 1 - start);
+                memcpy(file.data() + fileUsed, &ring[start], count * sizeof(TraceRecord));
+                fileUsed += count * sizeof(TraceRecord);
+                read += count;
+            }
+            writtenRecords += bytes / sizeof(TraceRecord);
+            readIndex.store(write, memory_order_release);
+        }
+
+        void writerLoop() {
+            unique_lock<mutex> lock(writerMutex);
+            while (running) {
+                lock.unlock();
+                drain();
+                lock.lock();
+                writerCondition.wait_for(lock, 1ms, [this] { return !running; });
+            }
+            lock.unlock();
+            drain();
+        }
+
+    public:
+        // 'ringRecords' bounds how far the bus may run ahead of the writer
+        // thread (24 bytes per record; the default buffers about 250 ms at
+        // 1M frames/s)
+        explicit TraceRecorder(const string& path, size_t ringRecords = size_t(1) << 18) {
+            size_t capacity = 64;
+            while (capacity < ringRecords) capacity <<= 1;
+            ring = make_unique<TraceRecord[]>(capacity);
+            ringMask = capacity - 1;
+
+            file = MappedFile::create(path, FILE_GROWTH);
+            writerThread = thread(&TraceRecorder::writerLoop, this);
+        }
+
+        ~TraceRecorder() {
+            close();
+        }
+
+        TraceRecorder(const TraceRecorder&) = delete;
+        TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+        // Starts recording a bus; a recorder captures one bus at a time
+        void attach(const shared_ptr<CANBus>& bus) {
+            if (closed) throw logic_error("Trace recorder is closed");
+            if (!attachedBus.expired()) throw logic_error("Trace recorder is already attached to a bus");
+            attachedBus = bus;
+            observerId = bus->addFrameObserver([this](const CANMessage& message, steady_clock::time_point completed) {
+                record(message, completed);
+            });
+        }
+
+        // Appends a frame stamped with its own timestamp, waiting for ring
+        // space instead of dropping. For converting other logs to traces;
+        // not for use while attached to a bus.
+        void write(const CANMessage& message) {
+            if (closed) throw logic_error("Trace recorder is closed");
+            if (!attachedBus.expired()) throw logic_error("Trace recorder is attached to a bus");
+            record(message, message.timestamp, true);
+        }
+
+        // Stops recording; no frame is recorded once this returns
+        void detach() {
+            if (auto bus = attachedBus.lock()) {
+                bus->removeFrameObserver(observerId);
+            }
+            attachedBus.reset();
+        }
+
+        // Detaches, writes out everything queued and finalizes the file
+        void close() {
+            if (closed) return;
+            detach();
+            {
+                lock_guard<mutex> lock(writerMutex);
+                running = false;
+            }
+            writerCondition.notify_all();
+            writerThread.join();
+
+            TraceFileHeader header{};
+            memcpy(header.magic, TraceFileHeader::MAGIC, sizeof(header.magic));
+            header.version = TraceFileHeader::VERSION;
+            header.recordSize = sizeof(TraceRecord);
+            header.startTimeNs = startTimeNs.load(memory_order_relaxed);
+            header.frameCount = recordedFrames.load(memory_order_relaxed);
+            header.recordCount = writtenRecords;
+            memcpy(file.data(), &header, sizeof(header));
+            file.close(fileUsed);
+            closed = true;
+        }
+
+        uint64_t getRecordedFrames() const { return recordedFrames.load(memory_order_relaxed); }
+        uint64_t getDroppedFrames() const { return droppedFrames.load(memory_order_relaxed); }
+    };
+
+    // ========================================
+    // Trace Reader and Replay
+    // ========================================
+
+    enum class ReplayTiming {
+        ORIGINAL = 0,               // Keep the recorded spacing between frames
+        AS_FAST_AS_POSSIBLE = 1     // Keep the bus transmit queue full
+    };
+
+    // Sequential decoder over the records of a mapped trace
+    class TraceCursor {
+    private:
+        const TraceRecord* current;
+        const TraceRecord* end;
+        int64_t timeNs;
+
+    public:
+        TraceCursor(const TraceRecord* first, const TraceRecord* last, int64_t startTimeNs)
+            : current(first), end(last), timeNs(startTimeNs) {}
+
+        // Decodes the next frame; false at the end of the trace (or at a
+        // truncated last frame)
+        bool next(CANMessage& message, int64_t& frameTimeNs) {
+            while (current < end) {
+                const TraceRecord& record = *current;
+                if (record.flags & TraceRecord::TIME_EXTENSION) {
+                    uint64_t delta;
+                    memcpy(&delta, record.data, sizeof(delta));
+                    timeNs += static_cast<int64_t>(delta);
+                    ++current;
+                    continue;
+                }
+                // The copy length comes from the DLC, so a corrupt record whose
+                // continuation count disagrees with it would read past the file
+                bool remote = (record.idFlags & TraceRecord::REMOTE) != 0;
+                bool fd = (record.idFlags & TraceRecord::FD) != 0;
+                size_t payloadBytes = remote ? 0 : (fd ? canFdDlcToLength(record.dlc) : min<size_t>(record.dlc, 8));
+                if (TraceRecord::continuationsFor(payloadBytes) != record.continuations ||
+                    static_cast<size_t>(end - current) <= record.continuations) {
+                    current = end;
+                    return false;
+                }
+
+                timeNs += record.timeDelta;
+                frameTimeNs = timeNs;
+                message.id = record.idFlags & TraceRecord::ID_MASK;
+                message.nodeId = record.nodeId;
+                message.timestamp = steady_clock::time_point(nanoseconds(timeNs));
+                message.format = (record.idFlags & TraceRecord::EXTENDED) ? CANFormat::EXTENDED : CANFormat::STANDARD;
+                message.rtr = remote;
+                message.frameType = message.rtr ? CANFrameType::REMOTE_FRAME : CANFrameType::DATA_FRAME;
+                message.fd = fd;
+                message.brs = (record.flags & TraceRecord::BRS) != 0;
+                message.esi = (record.flags & TraceRecord::ESI) != 0;
+                message.dlc = record.dlc;
+
+                message.data.resize(payloadBytes);
+                uint8_t* payload = message.data.data();
+                memcpy(payload, record.data, min(payloadBytes, TraceRecord::INLINE_BYTES));
+                if (payloadBytes > TraceRecord::INLINE_BYTES) {
+                    memcpy(payload + TraceRecord::INLINE_BYTES, current + 1, payloadBytes - TraceRecord::INLINE_BYTES);
+                }
+                current += 1 + record.continuations;
+                return true;
+            }
+            return false;
+        }
+    };
+
+    class TraceReplay;
+
+    // Opens a trace file through a read-only memory mapping
+    class TraceReader {
+    private:
+        shared_ptr<MappedFile> file;
+        TraceFileHeader header{};
+        const TraceRecord* records = nullptr;
+        size_t recordCount = 0;
+
+    public:
+        explicit TraceReader(const string& path)
+            : file(make_shared<MappedFile>(MappedFile::openForRead(path))) {
+            if (file->size() < sizeof(TraceFileHeader)) {
+                throw runtime_error("Not a CAN trace file: " + path);
+            }
+            memcpy(&header, file->data(), sizeof(header));
+            if (memcmp(header.magic, TraceFileHeader::MAGIC, sizeof(header.magic)) != 0 ||
+                header.recordSize != sizeof(TraceRecord)) {
+                throw runtime_error("Not a CAN trace file: " + path);
+            }
+            if (header.version != TraceFileHeader::VERSION) {
+                throw runtime_error("Unsupported CAN trace version " + to_string(header.version) + ": " + path);
+            }
+            records = reinterpret_cast<const TraceRecord*>(file->data() + sizeof(TraceFileHeader));
+            recordCount = min<size_t>(header.recordCount, (file->size() - sizeof(TraceFileHeader)) / sizeof(TraceRecord));
+        }
+
+        uint64_t getFrameCount() const { return header.frameCount; }
+        steady_clock::time_point getStartTime() const { return steady_clock::time_point(nanoseconds(header.startTimeNs)); }
+
+        TraceCursor cursor() const {
+            return TraceCursor(records, records + recordCount, header.startTimeNs);
+        }
+
+        // Offline analysis: calls visitor(const CANMessage&) for every frame,
+        // timestamps set to the recorded bus time. Returns the frame count.
+        template<typename Visitor>
+        uint64_t forEach(Visitor&& visitor) const {
+            TraceCursor frames = cursor();
+            CANMessage message;
+            int64_t timeNs = 0;
+            uint64_t count = 0;
+            while (frames.next(message, timeNs)) {
+                visitor(static_cast<const CANMessage&>(message));
+                ++count;
+            }
+            return count;
+        }
+
+        // Re-injects the trace into a bus, starting now; see TraceReplay
+        shared_ptr<TraceReplay> replay(const shared_ptr<CANBus>& bus, ReplayTiming timing = ReplayTiming::ORIGINAL) const;
+
+        friend class TraceReplay;
+    };
+
+    // A trace being replayed into a bus by a chain of bus timers. The replay
+    // keeps the mapping alive, so the reader may go away first. Injected
+    // frames are timestamped with the bus time they are queued at.
+    //
+    // AS_FAST_AS_POSSIBLE paces injection at the wire time of the replayed
+    // frames, keeping FAST_REPLAY_LEAD of traffic queued ahead of the bus:
+    // the bus stays saturated without the whole trace piling up in its
+    // arbitration queue.
+    class TraceReplay : public enable_shared_from_this<TraceReplay> {
+    private:
+        static constexpr nanoseconds FAST_REPLAY_LEAD = 2ms;
+
+        shared_ptr<MappedFile> file;        // keeps the records mapped
+        TraceCursor frames;
+        CANBus* bus;
+        ReplayTiming timing;
+        steady_clock::time_point origin;    // bus time of the first frame
+        int64_t firstTimeNs;
+
+        CANMessage pendingFrame;            // bus timer thread only
+        int64_t pendingTimeNs = 0;
+        bool havePending = false;
+        steady_clock::time_point paceTime;  // AS_FAST_AS_POSSIBLE: wire time queued so far
+
+        atomic<bool> stopping{false};
+        atomic<bool> finished{false};
+        atomic<uint64_t> injectedFrames{0};
+
+        // Bus timer: queues every frame that is due, then re-arms for the
+        // next one (or for when the transmit queue has room again)
+        void step() {
+            if (stopping.load(memory_order_relaxed)) {
+                finished.store(true);
+                return;
+            }
+            auto now = bus->now();
+            paceTime = max(paceTime, now);
+            while (havePending || frames.next(pendingFrame, pendingTimeNs)) {
+                havePending = true;
+                if (timing == ReplayTiming::ORIGINAL) {
+                    auto due = origin + nanoseconds(pendingTimeNs - firstTimeNs);
+                    if (due > now) {
+                        rearm(due);
+                        return;
+                    }
+                } else if (paceTime > now + FAST_REPLAY_LEAD) {
+                    rearm(paceTime - FAST_REPLAY_LEAD);
+                    return;
+                }
+                pendingFrame.timestamp = now;
+                if (!bus->transmitMessage(pendingFrame)) {
+                    if (!bus->isActive()) break;
+                    rearm(now + bus->frameDuration(pendingFrame));
+                    return;
+                }
+                havePending = false;
+                paceTime += bus->frameDuration(pendingFrame);
+                injectedFrames.fetch_add(1, memory_order_relaxed);
+            }
+            finished.store(true);
+        }
+
+        void rearm(steady_clock::time_point when) {
+            bus->scheduleAt(when, [self = shared_from_this()] { self->step(); });
+        }
+
+    public:
+        TraceReplay(const TraceReader& reader, CANBus& targetBus, ReplayTiming replayTiming)
+            : file(reader.file), frames(reader.cursor()), bus(&targetBus), timing(replayTiming),
+              origin(targetBus.now()), firstTimeNs(reader.header.startTimeNs) {}
+
+        void start() {
+            rearm(origin);
+        }
+
+        // Stops at the next frame; the pending timer ends the replay
+        void stop() { stopping.store(true); }
+
+        bool isFinished() const { return finished.load(); }
+        uint64_t getInjectedFrames() const { return injectedFrames.load(memory_order_relaxed); }
+    };
+
+    inline shared_ptr<TraceReplay> TraceReader::replay(const shared_ptr<CANBus>& bus, ReplayTiming timing) const {
+        auto session = make_shared<TraceReplay>(*this, *bus, timing);
+        session->start();
+        return session;
+    }
+
+} // namespace CANSim
@@ -14,6 +14,7 @@ module;
 export module HeadlightControl;
 
 import CANBusSimulation;
+import CANDatabase;
 
 using namespace std;
 using namespace std::chrono;
@@ -33,18 +34,50 @@ export namespace HeadlightControl {
         AUTO = 2
     };
 
+    // Typed payloads of the three frames
+    struct UserInput {
+        HeadlightState requested = HeadlightState::OFF;
+
+        using Layout = CANSim::MessageLayout<USER_INPUT_ID, 1,
+            CANSim::SignalField<&UserInput::requested, 0, 8>>;
+    };
+
+    struct HeadlightCommand {
+        HeadlightState state = HeadlightState::OFF;
+        uint8_t validity = 0xFF;    // command validity flag
+
+        using Layout = CANSim::MessageLayout<HEADLIGHT_COMMAND_ID, 2,
+            CANSim::SignalField<&HeadlightCommand::state, 0, 8>,
+            CANSim::SignalField<&HeadlightCommand::validity, 8, 8>>;
+    };
+
+    struct HeadlightStatus {
+        HeadlightState mode = HeadlightState::OFF;
+        bool lightsOn = false;
+        uint8_t validity = 0xAA;    // status validity flag
+
+        using Layout = CANSim::MessageLayout<HEADLIGHT_STATUS_ID, 3,
+            CANSim::SignalField<&HeadlightStatus::mode, 0, 8>,
+            CANSim::SignalField<&HeadlightStatus::lightsOn, 8, 8>,
+            CANSim::SignalField<&HeadlightStatus::validity, 16, 8>>;
+    };
+
     // User Input Controller (simulates dashboard switch)
     class UserInputController {
     private:
         shared_ptr<CANSim::CANBus> canBus;
+        shared_ptr<CANSim::CANNode> canNode;
         uint8_t nodeId;
         atomic<bool> running{ true };
-        thread inputThread;
+        thread inputThread;         // blocks on stdin, so it keeps its own thread
 
     public:
         UserInputController(shared_ptr<CANSim::CANBus> bus, uint8_t id)
             : canBus(bus), nodeId(id) {
             
+            canNode = make_shared<CANSim::CANNode>(nodeId, "User_Input");
+            canBus->addNode(canNode);
+            
             cout << "[USER_INPUT] Controller initialized (Node ID: 0x" 
                  << hex << (int)nodeId << dec << ")" << endl;
             
@@ -96,12 +129,9 @@ export namespace HeadlightControl {
         }
 
         void sendHeadlightCommand(HeadlightState state) {
-            CANSim::CANMessage msg;
-            msg.id = USER_INPUT_ID;
-            msg.length = 1;
-            msg.data[0] = static_cast<uint8_t>(state);
+            auto msg = canNode->createMessage(UserInput::Layout::id, UserInput::Layout::encode({ state }));
             
-            canBus->sendMessage(msg);
+            canBus->transmitMessage(msg);
             cout << "[USER_INPUT] CAN message sent: ID=0x" << hex << msg.id 
                  << ", Data=0x" << (int)msg.data[0] << dec << endl;
         }
@@ -115,9 +145,9 @@ export namespace HeadlightControl {
     class HeadlightECU {
     private:
         shared_ptr<CANSim::CANBus> canBus;
+        shared_ptr<CANSim::CANNode> canNode;
         uint8_t nodeId;
-        atomic<bool> running{ true };
-        thread messageThread;
+        CANSim::TimerId heartbeatTimer = 0;
         HeadlightState currentMode{ HeadlightState::OFF };
 
     public:
@@ -128,23 +158,24 @@ export namespace HeadlightControl {
                  << hex << (int)nodeId << dec << ")" << endl;
             
             // Register for CAN messages
-            canBus->registerNode(nodeId, [this](const CANSim::CANMessage& msg) {
+            canNode = make_shared<CANSim::CANNode>(nodeId, "Headlight_ECU");
+            canNode->addAcceptanceFilter(CANSim::AcceptanceFilter::exact(USER_INPUT_ID));
+            canNode->setMessageHandler([this](const CANSim::CANMessage& msg) {
                 this->onCANMessage(msg);
             });
+            canBus->addNode(canNode);
             
-            messageThread = thread(&HeadlightECU::messageLoop, this);
+            heartbeatTimer = canBus->schedulePeriodic(1s, [this] { heartbeat(); });
         }
 
         ~HeadlightECU() {
-            running = false;
-            if (messageThread.joinable()) {
-                messageThread.join();
-            }
+            stop();
         }
 
         void onCANMessage(const CANSim::CANMessage& msg) {
-            if (msg.id == USER_INPUT_ID) {
-                HeadlightState requestedState = static_cast<HeadlightState>(msg.data[0]);
+            UserInput input;
+            if (msg.id == USER_INPUT_ID && UserInput::Layout::decode(msg, input)) {
+                HeadlightState requestedState = input.requested;
                 cout << "[ECU] Received user command: ";
                 
                 switch (requestedState) {
@@ -165,27 +196,24 @@ export namespace HeadlightControl {
         }
 
         void sendHeadlightControlCommand(HeadlightState state) {
-            CANSim::CANMessage msg;
-            msg.id = HEADLIGHT_COMMAND_ID;
-            msg.length = 2;
-            msg.data[0] = static_cast<uint8_t>(state);
-            msg.data[1] = 0xFF; // Command validity flag
+            auto msg = canNode->createMessage(HeadlightCommand::Layout::id,
+                HeadlightCommand::Layout::encode({ state }));
             
-            canBus->sendMessage(msg);
+            canBus->transmitMessage(msg);
             cout << "[ECU] Sending headlight command to controller: State=" 
                  << (int)state << endl;
         }
 
-        void messageLoop() {
-            while (running) {
-                // ECU could perform additional logic here
-                // For now, just a heartbeat
-                this_thread::sleep_for(1s);
-            }
+        void heartbeat() {
+            // ECU could perform additional logic here
+            // For now, just a heartbeat
         }
 
         void stop() {
-            running = false;
+            if (heartbeatTimer != 0) {
+                canBus->cancelTimer(heartbeatTimer);
+                heartbeatTimer = 0;
+            }
         }
     };
 
@@ -193,9 +221,9 @@ export namespace HeadlightControl {
     class HeadlightController {
     private:
         shared_ptr<CANSim::CANBus> canBus;
+        shared_ptr<CANSim::CANNode> canNode;
         uint8_t nodeId;
-        atomic<bool> running{ true };
-        thread controlThread;
+        CANSim::TimerId statusTimer = 0;
         HeadlightState currentState{ HeadlightState::OFF };
         bool lightsPhysicallyOn{ false };
 
@@ -207,23 +235,25 @@ export namespace HeadlightControl {
                  << hex << (int)nodeId << dec << ")" << endl;
             
             // Register for CAN messages
-            canBus->registerNode(nodeId, [this](const CANSim::CANMessage& msg) {
+            canNode = make_shared<CANSim::CANNode>(nodeId, "Headlight_Controller");
+            canNode->addAcceptanceFilter(CANSim::AcceptanceFilter::exact(HEADLIGHT_COMMAND_ID));
+            canNode->setMessageHandler([this](const CANSim::CANMessage& msg) {
                 this->onCANMessage(msg);
             });
+            canBus->addNode(canNode);
             
-            controlThread = thread(&HeadlightController::controlLoop, this);
+            // Periodic status updates
+            statusTimer = canBus->schedulePeriodic(3s, [this] { sendStatusUpdate(); });
         }
 
         ~HeadlightController() {
-            running = false;
-            if (controlThread.joinable()) {
-                controlThread.join();
-            }
+            stop();
         }
 
         void onCANMessage(const CANSim::CANMessage& msg) {
-            if (msg.id == HEADLIGHT_COMMAND_ID) {
-                HeadlightState commandedState = static_cast<HeadlightState>(msg.data[0]);
+            HeadlightCommand command;
+            if (msg.id == HEADLIGHT_COMMAND_ID && HeadlightCommand::Layout::decode(msg, command)) {
+                HeadlightState commandedState = command.state;
                 cout << "[HEADLIGHT_CTRL] Received command from ECU: ";
                 
                 switch (commandedState) {
@@ -257,28 +287,19 @@ export namespace HeadlightControl {
         }
 
         void sendStatusUpdate() {
-            CANSim::CANMessage msg;
-            msg.id = HEADLIGHT_STATUS_ID;
-            msg.length = 3;
-            msg.data[0] = static_cast<uint8_t>(currentState);
-            msg.data[1] = lightsPhysicallyOn ? 1 : 0;
-            msg.data[2] = 0xAA; // Status validity flag
+            auto msg = canNode->createMessage(HeadlightStatus::Layout::id,
+                HeadlightStatus::Layout::encode({ currentState, lightsPhysicallyOn }));
             
-            canBus->sendMessage(msg);
+            canBus->transmitMessage(msg);
             cout << "[HEADLIGHT_CTRL] Status update sent: Mode=" << (int)currentState 
                  << ", Physical=" << (lightsPhysicallyOn ? "ON" : "OFF") << endl;
         }
 
-        void controlLoop() {
-            while (running) {
-                // Send periodic status updates
-                sendStatusUpdate();
-                this_thread::sleep_for(3s);
-            }
-        }
-
         void stop() {
-            running = false;
+            if (statusTimer != 0) {
+                canBus->cancelTimer(statusTimer);
+                statusTimer = 0;
+            }
         }
 
         bool isOn() const { return lightsPhysicallyOn; }